@@ -0,0 +1,236 @@
+#include "StringArena.hpp"
+#include <cstdint>
+#include <new>
+
+/*
+Slabs are aligned on their own size, so the slab owning a block is
+found by masking the block's address. The slab header sits at the
+start of the slab, followed by the blocks, which are handed out from
+the slab's free list first and from its never used tail otherwise.
+A slab is linked in the partial list of its class while it has room
+left, and in the full list otherwise.
+Large blocks are preceded by a header linking them together.
+*/
+
+struct StringArena::Slab {
+	Slab* prev;
+	Slab* next;
+	void* free_list;
+	size_t block_size;
+	size_t bump;  // offset of the first block never handed out
+	size_t live;
+	size_t cls;
+
+	bool hasRoom() const {
+		return this->free_list || this->bump + this->block_size <= SLAB_SIZE;
+	}
+};
+
+struct StringArena::LargeBlock {
+	LargeBlock* prev;
+	LargeBlock* next;
+	size_t size;
+	size_t padding;  // keeps the block that follows aligned on GRANULE
+};
+
+namespace {
+	constexpr size_t roundUp(size_t value, size_t granule) {
+		return (value + granule - 1) / granule * granule;
+	}
+
+	template<typename T>
+	void linkFront(T*& head, T* node) {
+		node->prev = nullptr;
+		node->next = head;
+		if (head)
+			head->prev = node;
+		head = node;
+	}
+
+	template<typename T>
+	void unlink(T*& head, T* node) {
+		if (node->prev)
+			node->prev->next = node->next;
+		else
+			head = node->next;
+		if (node->next)
+			node->next->prev = node->prev;
+	}
+}
+
+
+double StringArenaStats::fragmentation() const {
+	if (!this->reserved)
+		return 0;
+	return 1.0 - (double)this->requested / (double)this->reserved;
+}
+
+
+StringArena::StringArena() :
+	large(nullptr), large_bytes(0), large_requested(0)
+{
+	for (SizeClass& c : this->classes) {
+		c.partial = nullptr;
+		c.full = nullptr;
+		c.slab_count = 0;
+		c.live_blocks = 0;
+		c.requested = 0;
+	}
+}
+
+StringArena::~StringArena() {
+	for (SizeClass& c : this->classes) {
+		while (c.partial) {
+			Slab* slab = c.partial;
+			unlink(c.partial, slab);
+			::operator delete(slab, std::align_val_t(SLAB_SIZE));
+		}
+		while (c.full) {
+			Slab* slab = c.full;
+			unlink(c.full, slab);
+			::operator delete(slab, std::align_val_t(SLAB_SIZE));
+		}
+	}
+	while (this->large) {
+		LargeBlock* block = this->large;
+		unlink(this->large, block);
+		::operator delete(block);
+	}
+}
+
+size_t StringArena::classOf(size_t sz) {
+	if (!sz)
+		sz = 1;
+	return (sz + GRANULE - 1) / GRANULE - 1;
+}
+
+StringArena::Slab* StringArena::newSlab(size_t cls) {
+	Slab* slab = static_cast<Slab*>(::operator new(SLAB_SIZE, std::align_val_t(SLAB_SIZE)));
+	slab->prev = nullptr;
+	slab->next = nullptr;
+	slab->free_list = nullptr;
+	slab->block_size = (cls + 1) * GRANULE;
+	slab->bump = roundUp(sizeof(Slab), GRANULE);
+	slab->live = 0;
+	slab->cls = cls;
+	return slab;
+}
+
+void StringArena::freeSlab(SizeClass& c, Slab* slab) {
+	unlink(c.partial, slab);
+	c.slab_count--;
+	::operator delete(slab, std::align_val_t(SLAB_SIZE));
+}
+
+void* StringArena::allocate(size_t sz) {
+	if (sz > MAX_SMALL) {
+		LargeBlock* block = static_cast<LargeBlock*>(::operator new(sizeof(LargeBlock) + sz));
+		block->size = sz;
+		std::lock_guard<std::mutex> guard(this->large_lock);
+		linkFront(this->large, block);
+		this->large_bytes += sizeof(LargeBlock) + sz;
+		this->large_requested += sz;
+		return block + 1;
+	}
+
+	size_t cls = classOf(sz);
+	SizeClass& c = this->classes[cls];
+	std::lock_guard<std::mutex> guard(c.lock);
+	Slab* slab = c.partial;
+	if (!slab) {
+		slab = this->newSlab(cls);
+		linkFront(c.partial, slab);
+		c.slab_count++;
+	}
+
+	void* block;
+	if (slab->free_list) {
+		block = slab->free_list;
+		slab->free_list = *static_cast<void**>(block);
+	} else {
+		block = reinterpret_cast<char*>(slab) + slab->bump;
+		slab->bump += slab->block_size;
+	}
+	slab->live++;
+	c.live_blocks++;
+	c.requested += sz;
+
+	if (!slab->hasRoom()) {
+		unlink(c.partial, slab);
+		linkFront(c.full, slab);
+	}
+	return block;
+}
+
+void StringArena::deallocate(void* block, size_t sz) {
+	if (!block)
+		return;
+	if (sz > MAX_SMALL) {
+		LargeBlock* header = static_cast<LargeBlock*>(block) - 1;
+		{
+			std::lock_guard<std::mutex> guard(this->large_lock);
+			unlink(this->large, header);
+			this->large_bytes -= sizeof(LargeBlock) + header->size;
+			this->large_requested -= header->size;
+		}
+		::operator delete(header);
+		return;
+	}
+
+	Slab* slab = reinterpret_cast<Slab*>(reinterpret_cast<uintptr_t>(block) & ~(uintptr_t)(SLAB_SIZE - 1));
+	SizeClass& c = this->classes[slab->cls];
+	std::lock_guard<std::mutex> guard(c.lock);
+	bool was_full = !slab->hasRoom();
+	*static_cast<void**>(block) = slab->free_list;
+	slab->free_list = block;
+	slab->live--;
+	c.live_blocks--;
+	c.requested -= sz;
+
+	if (was_full) {
+		unlink(c.full, slab);
+		linkFront(c.partial, slab);
+	}
+	if (!slab->live && c.slab_count > 1) {
+		this->freeSlab(c, slab);
+	}
+}
+
+void* StringArena::allocateDetached(size_t sz) {
+	LargeBlock* block = static_cast<LargeBlock*>(::operator new(sizeof(LargeBlock) + sz));
+	block->prev = nullptr;
+	block->next = nullptr;
+	block->size = sz;
+	return block + 1;
+}
+
+void StringArena::freeDetached(void* block) {
+	if (block)
+		::operator delete(static_cast<LargeBlock*>(block) - 1);
+}
+
+void StringArena::attach(void* block) {
+	LargeBlock* header = static_cast<LargeBlock*>(block) - 1;
+	std::lock_guard<std::mutex> guard(this->large_lock);
+	linkFront(this->large, header);
+	this->large_bytes += sizeof(LargeBlock) + header->size;
+	this->large_requested += header->size;
+}
+
+StringArenaStats StringArena::stats() {
+	StringArenaStats res = {};
+	for (size_t cls = 0; cls < CLASS_COUNT; cls++) {
+		SizeClass& c = this->classes[cls];
+		std::lock_guard<std::mutex> guard(c.lock);
+		res.slabs += c.slab_count;
+		res.reserved += c.slab_count * SLAB_SIZE;
+		res.allocated += c.live_blocks * (cls + 1) * GRANULE;
+		res.requested += c.requested;
+	}
+	std::lock_guard<std::mutex> guard(this->large_lock);
+	res.reserved += this->large_bytes;
+	res.allocated += this->large_bytes;
+	res.requested += this->large_requested;
+	return res;
+}
+
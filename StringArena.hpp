@@ -0,0 +1,98 @@
+#pragma once
+#include <cstddef>
+#include <mutex>
+
+/*
+Occupancy figures of a StringArena, in bytes.
+*/
+struct StringArenaStats {
+	size_t slabs;      // number of slabs currently held
+	size_t reserved;   // bytes obtained from the system, slabs and large blocks
+	size_t allocated;  // bytes handed out, rounded up to their size class
+	size_t requested;  // bytes actually asked for
+
+	/*
+	Share of the reserved memory that holds no requested byte,
+	between 0 and 1. Covers both rounding to size classes and
+	free blocks left inside slabs.
+	*/
+	double fragmentation() const;
+};
+
+/*
+Size-class slab allocator backing the buffers of string resources.
+Blocks of up to MAX_SMALL bytes are carved out of SLAB_SIZE slabs,
+one size class per multiple of 16 bytes. Each slab keeps its own free
+list, and a slab whose blocks were all freed goes back to the system,
+except for the last one of its class. Larger blocks are forwarded to
+operator new.
+Every slab and large block is linked into the arena, so destroying
+the arena reclaims all of its memory at once without visiting the
+individual blocks.
+All member functions are thread-safe.
+*/
+class StringArena
+{
+public:
+	static constexpr size_t SLAB_SIZE = 64 * 1024;
+	static constexpr size_t GRANULE = 16;
+	static constexpr size_t MAX_SMALL = 256;
+
+private:
+	static constexpr size_t CLASS_COUNT = MAX_SMALL / GRANULE;
+
+	struct Slab;
+	struct LargeBlock;
+
+	struct SizeClass {
+		std::mutex lock;
+		Slab* partial;  // slabs with at least one free block
+		Slab* full;     // slabs without any
+		size_t slab_count;
+		size_t live_blocks;
+		size_t requested;
+	};
+
+	SizeClass classes[CLASS_COUNT];
+	std::mutex large_lock;
+	LargeBlock* large;
+	size_t large_bytes;
+	size_t large_requested;
+
+	static size_t classOf(size_t sz);
+	Slab* newSlab(size_t cls);
+	void freeSlab(SizeClass&, Slab*);
+
+public:
+	StringArena();
+	~StringArena();
+
+	/*
+	Returns a block of at least sz bytes, aligned on GRANULE bytes.
+	Throws std::bad_alloc if memory is exhausted.
+	*/
+	void* allocate(size_t sz);
+	/*
+	Gives back a block obtained from allocate. sz must be the size
+	that was requested for it.
+	*/
+	void deallocate(void* block, size_t sz);
+	/*
+	Returns a large block of at least sz bytes, aligned on GRANULE
+	bytes, that belongs to no arena yet, so that it can outlive any
+	of them. It is given back through freeDetached, unless attach
+	hands it over to an arena, which then frees it like its own large
+	blocks. Throws std::bad_alloc if memory is exhausted.
+	*/
+	static void* allocateDetached(size_t sz);
+	static void freeDetached(void* block);
+	void attach(void* block);
+	/*
+	Returns the current occupancy of the arena.
+	*/
+	StringArenaStats stats();
+
+	StringArena(const StringArena&) = delete;
+	StringArena& operator =(const StringArena&) = delete;
+};
+
@@ -1,38 +1,95 @@
 #include "StringResource.hpp"
-#include "strhash.h"
+#include <climits>
 #include <cstdlib>
+#include <cstring>
+#include <new>
 
-StringResource::StringResource() {
-	this->contents = nullptr;
-	this->size = 0;
-	this->_hash = 0;
-	this->refcnt = 0;
+namespace {
+#ifdef STRLIB_COUNT_REFS
+	std::atomic<size_t> ref_count_writes(0);
+#endif
+
+	inline void countWrite() {
+#ifdef STRLIB_COUNT_REFS
+		ref_count_writes.fetch_add(1, std::memory_order_relaxed);
+#endif
+	}
+}
+
+StringResource::StringResource(size_t sz, hash_t hash) :
+	refcnt(0), size(sz), _hash(hash)
+{}
+
+size_t StringResource::allocationSize(size_t sz) {
+	return sizeof(StringResource) + sz + 1;
+}
+
+StringResource* StringResource::create(StringArena& arena, const char* contents, size_t sz, hash_t hash) {
+	void* block = arena.allocate(allocationSize(sz));
+	StringResource* res = new (block) StringResource(sz, hash);
+	char* buf = reinterpret_cast<char*>(res + 1);
+	std::memcpy(buf, contents, sz);
+	buf[sz] = 0;
+	return res;
 }
 
-StringResource::StringResource(const char* contents, size_t sz) {
-	bool isNullTerminated = contents[sz - 1] == 0;
+StringResource* StringResource::adopt(void* block, size_t sz, hash_t hash) {
+	StringResource* res = new (block) StringResource(sz, hash);
+	reinterpret_cast<char*>(res + 1)[sz] = 0;
+	return res;
+}
 
-	this->size = isNullTerminated ? sz - 1 : sz;
-	char* buf = new char[this->size + 1];
-	std::memcpy(buf, contents, this->size);
-	buf[this->size] = 0;
-	this->contents = buf;
+char* StringResource::contentsOf(void* block) {
+	return reinterpret_cast<char*>(static_cast<StringResource*>(block) + 1);
+}
 
-	this->_hash = computeHash(this->contents, this->size);
-	this->refcnt = 0;
+void* StringResource::blockOf(char* contents) {
+	return reinterpret_cast<StringResource*>(contents) - 1;
 }
 
 hash_t StringResource::hash() {
 	return this->_hash;
 }
 
-void StringResource::incref() {
-	this->refcnt++;
+void StringResource::incref(size_t count) {
+	// a pinned resource is only read, so its cache line is never contended for.
+	if (this->refcnt.load(std::memory_order_relaxed) >= IMMORTAL)
+		return;
+	this->refcnt.fetch_add(count, std::memory_order_relaxed);
+	countWrite();
 }
 
 void StringResource::decref() {
-	if (this->refcnt > 0)
-		this->refcnt--;
+	size_t count = this->refcnt.load(std::memory_order_relaxed);
+	while (count > 0 && count < IMMORTAL) {
+		if (this->refcnt.compare_exchange_weak(count, count - 1, std::memory_order_acq_rel)) {
+			countWrite();
+			return;
+		}
+	}
+}
+
+bool StringResource::tryDecref(size_t count) {
+	size_t current = this->refcnt.load(std::memory_order_relaxed);
+	while (current > count) {
+		if (current >= IMMORTAL)
+			return 1;
+		if (this->refcnt.compare_exchange_weak(current, current - count, std::memory_order_acq_rel)) {
+			countWrite();
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void StringResource::pin() {
+	size_t count = this->refcnt.load(std::memory_order_relaxed);
+	while (count < IMMORTAL && !this->refcnt.compare_exchange_weak(count, count + IMMORTAL, std::memory_order_relaxed))
+		;
+}
+
+bool StringResource::isPinned() {
+	return this->refcnt.load(std::memory_order_relaxed) >= IMMORTAL;
 }
 
 size_t StringResource::getSize() {
@@ -42,25 +99,26 @@ size_t StringResource::getSize() {
 int16_t StringResource::getChar(size_t index) {
 	if (index >= this->size)
 		return CHAR_MAX + 1;
-	return this->contents[index];
+	return this->buffer()[index];
 }
 
 size_t StringResource::getRefCnt() {
-	return this->refcnt;
+	return this->refcnt.load(std::memory_order_acquire);
 }
 
-const char* StringResource::buffer() {
-	return this->contents;
+#ifdef STRLIB_COUNT_REFS
+size_t StringResource::refCountWrites() {
+	return ref_count_writes.load(std::memory_order_relaxed);
 }
+#endif
 
-void StringResource::release() {
-	if (!this->contents)
-		return;
-	delete this->contents;
+const char* StringResource::buffer() {
+	return reinterpret_cast<const char*>(this + 1);
 }
 
-StringResource::operator bool() {
-	return this->contents != nullptr;
+void StringResource::release(StringArena& arena) {
+	size_t sz = allocationSize(this->size);
+	this->~StringResource();
+	arena.deallocate(this, sz);
 }
 
-
@@ -1,26 +1,93 @@
 #pragma once
-#include <vector>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "StringArena.hpp"
 #include "resource.hpp"
 
+/*
+A single interned string along with its number of bindings.
+The object is only a header: the bytes of the string, followed by a
+terminating zero, are stored right after it in the same allocation,
+so the reference count, size, hash and contents share cache lines.
+Resources are created and released through a StringArena.
+The reference count is atomic, so bindings can be added and dropped
+from any thread. Everything else is immutable once constructed.
+A resource can be pinned, which makes it immortal: its reference
+count is raised by IMMORTAL and never written to again, so threads
+binding it concurrently only share its cache line for reading, and
+it is never discarded. Pinning is only ever asked for explicitly, so
+that how many bindings a resource happens to have never keeps its
+memory from being reclaimed.
+*/
 class StringResource
 {
-	size_t refcnt;
+	static constexpr size_t IMMORTAL = (SIZE_MAX >> 1) + 1;
+
+	std::atomic<size_t> refcnt;
 	size_t size;
 	hash_t _hash;
-	const char* contents;
+
+	StringResource(size_t sz, hash_t hash);
 
 public:
-	StringResource();
-	StringResource(const char* contents, size_t sz);
+	/*
+	Returns the number of bytes taken by a resource holding sz bytes.
+	*/
+	static size_t allocationSize(size_t sz);
+	/*
+	Returns where the contents of a resource go in a block obtained
+	from an arena, and the other way round.
+	*/
+	static char* contentsOf(void* block);
+	static void* blockOf(char* contents);
+	/*
+	Allocates a resource holding a copy of the sz bytes of contents
+	from the specified arena. The resource starts with no binding.
+	*/
+	static StringResource* create(StringArena& arena, const char* contents, size_t sz, hash_t hash);
+	/*
+	Turns a block of the arena whose contents, as given by contentsOf,
+	already hold the sz bytes of the string into a resource, without
+	copying them. The block must be large enough for the terminator,
+	and allocationSize(sz) must exceed StringArena::MAX_SMALL, so that
+	the arena finds the actual size of the block when it is released.
+	The resource starts with no binding.
+	*/
+	static StringResource* adopt(void* block, size_t sz, hash_t hash);
 
 	hash_t hash();
-	void incref();
+	void incref(size_t count = 1);
 	void decref();
+	/*
+	Drops count references unless that would drop the last one.
+	Returns whether they were dropped.
+	*/
+	bool tryDecref(size_t count = 1);
+	/*
+	Makes the resource immortal. Pinning it again has no effect.
+	*/
+	void pin();
+	bool isPinned();
 	size_t getRefCnt();
-	void release();
+#ifdef STRLIB_COUNT_REFS
+	/*
+	Number of writes made so far to the reference counts of all
+	resources, by every thread. Only kept when the library is built
+	with STRLIB_COUNT_REFS defined, for bench_refcount.cpp.
+	*/
+	static size_t refCountWrites();
+#endif
+	/*
+	Gives the memory of the resource back to the arena it was
+	created from. The resource must not be used afterwards.
+	*/
+	void release(StringArena& arena);
 	size_t getSize();
 	int16_t getChar(size_t index);
 	const char* buffer();
-	operator bool();
+
+	StringResource(const StringResource&) = delete;
+	StringResource& operator =(const StringResource&) = delete;
 };
 
@@ -0,0 +1,115 @@
+#include "StringResourceIndex.hpp"
+#include "prefetch.h"
+#include <cstdint>
+
+/*
+Entries are probed linearly starting from a bucket derived from the
+high bits of the hash multiplied by a large odd constant, which spreads
+hashes whose low bits are poorly distributed.
+The table is kept at most 3/4 full, tombstones included, and its
+capacity is always a power of two.
+*/
+
+constexpr resource_t EMPTY_entry = -1;
+constexpr resource_t TOMBSTONE_entry = -2;
+constexpr size_t MIN_capacity = 16;
+
+
+StringResourceIndex::StringResourceIndex() :
+	entries(), used(0), tombstones(0), bits(0)
+{}
+
+size_t StringResourceIndex::startOf(hash_t hash) const {
+	uint64_t mixed = (uint64_t)hash * 0x9E3779B97F4A7C15ull;
+	return (size_t)(mixed >> (64 - this->bits));
+}
+
+void StringResourceIndex::rebuild(size_t capacity) {
+	std::vector<Entry> previous = std::move(this->entries);
+	this->entries = std::vector<Entry>(capacity, Entry{ 0, EMPTY_entry });
+	this->bits = 0;
+	while (((size_t)1 << this->bits) < capacity)
+		this->bits++;
+	this->tombstones = 0;
+
+	size_t mask = capacity - 1;
+	for (const Entry& entry : previous) {
+		if (entry.resource < 0)
+			continue;
+		size_t pos = this->startOf(entry.hash);
+		while (this->entries[pos].resource != EMPTY_entry)
+			pos = (pos + 1) & mask;
+		this->entries[pos] = entry;
+	}
+}
+
+void StringResourceIndex::prefetch(hash_t hash) const {
+	if (this->entries.empty())
+		return;
+	prefetchRead(&this->entries[this->startOf(hash)]);
+}
+
+resource_t StringResourceIndex::next(hash_t hash, size_t* cursor) const {
+	size_t capacity = this->entries.size();
+	if (!capacity)
+		return -1;
+	size_t mask = capacity - 1;
+	size_t start = this->startOf(hash);
+	while (*cursor < capacity) {
+		const Entry& entry = this->entries[(start + *cursor) & mask];
+		(*cursor)++;
+		if (entry.resource == EMPTY_entry)
+			break;
+		if (entry.resource >= 0 && entry.hash == hash)
+			return entry.resource;
+	}
+	*cursor = capacity;  // exhausted, further calls keep failing
+	return -1;
+}
+
+void StringResourceIndex::insert(hash_t hash, resource_t index) {
+	size_t capacity = this->entries.size();
+	if ((this->used + this->tombstones + 1) * 4 > capacity * 3) {
+		// grow only when live entries need it, otherwise just purge the tombstones.
+		size_t new_capacity = capacity < MIN_capacity ? MIN_capacity : capacity;
+		while ((this->used + 1) * 2 > new_capacity)
+			new_capacity *= 2;
+		this->rebuild(new_capacity);
+		capacity = new_capacity;
+	}
+
+	size_t mask = capacity - 1;
+	size_t pos = this->startOf(hash);
+	while (this->entries[pos].resource >= 0)
+		pos = (pos + 1) & mask;
+	if (this->entries[pos].resource == TOMBSTONE_entry)
+		this->tombstones--;
+	this->entries[pos] = Entry{ hash, index };
+	this->used++;
+}
+
+bool StringResourceIndex::erase(hash_t hash, resource_t index) {
+	size_t capacity = this->entries.size();
+	if (!capacity)
+		return 0;
+	size_t mask = capacity - 1;
+	size_t pos = this->startOf(hash);
+	for (size_t i = 0; i < capacity; i++) {
+		Entry& entry = this->entries[pos];
+		if (entry.resource == EMPTY_entry)
+			return 0;
+		if (entry.resource == index && entry.hash == hash) {
+			entry.resource = TOMBSTONE_entry;
+			this->used--;
+			this->tombstones++;
+			return 1;
+		}
+		pos = (pos + 1) & mask;
+	}
+	return 0;
+}
+
+size_t StringResourceIndex::size() const {
+	return this->used;
+}
+
@@ -0,0 +1,59 @@
+#pragma once
+#include "resource.hpp"
+#include <cstddef>
+#include <vector>
+
+/*
+Open-addressing hash index over the slots of a StringResourceList.
+Each entry remembers the full hash next to the slot it points to,
+so probing never has to look at a resource whose hash differs.
+Several resources may share the same hash: lookups walk the probe
+sequence through a cursor and hand out every candidate in turn,
+leaving it to the caller to confirm the match by comparing bytes.
+Removed entries become tombstones. They are recycled by later
+insertions and purged whenever the table is rebuilt.
+*/
+class StringResourceIndex
+{
+	struct Entry {
+		hash_t hash;
+		resource_t resource;
+	};
+
+	std::vector<Entry> entries;
+	size_t used;
+	size_t tombstones;
+	unsigned int bits;
+
+	size_t startOf(hash_t) const;
+	void rebuild(size_t capacity);
+
+public:
+	StringResourceIndex();
+
+	/*
+	Returns the next slot registered under the specified hash, or -1
+	once every candidate has been visited. *cursor holds the position
+	in the probe sequence and must be set to 0 before the first call.
+	*/
+	resource_t next(hash_t hash, size_t* cursor) const;
+	/*
+	Registers the slot index under the specified hash.
+	*/
+	void insert(hash_t hash, resource_t index);
+	/*
+	Removes the entry mapping hash to index, leaving a tombstone
+	in its place. Returns whether the entry was found.
+	*/
+	bool erase(hash_t hash, resource_t index);
+	/*
+	Starts loading the first bucket probed for the specified hash
+	into the cache, ahead of a lookup.
+	*/
+	void prefetch(hash_t hash) const;
+	/*
+	Returns the number of live entries.
+	*/
+	size_t size() const;
+};
+
@@ -1,5 +1,8 @@
 #include "StringResourceList.hpp"
+#include "prefetch.h"
 #include "strhash.h"
+#include <climits>
+#include <cstring>
 #include <iostream>
 
 /*
@@ -9,27 +12,109 @@ position in the list is pushed to the positional stack.
 Each time a new StringResource object is added to the list, 
 its position is popped from the positional stack. If the positional
 stack is empty, the object is appended to the list.
-Each StringResource object owns a buffer of const chars that stores
-a string.
+Each slot points to a StringResource allocated from the arena, which
+stores the string right after its header.
+Every live resource is also registered in the hash index under its
+hash. Discarding a resource leaves a tombstone in the index, and the
+slot is registered again under its new hash once it is reused.
+
+Locking:
+The hash index is split in shards, each guarded by its own mutex, so
+lookups of unrelated strings don't contend. Reference counts are
+atomic and are raised or lowered without any lock, except when the
+last reference is about to be dropped: that only happens while the
+shard owning the resource is locked, which is also the only place a
+lookup can bind to an existing resource. A resource is therefore
+never found by a lookup once it started being discarded, and its slot
+is only handed out again after every binding to it is gone.
+Slots never move once allocated, so they are read without locking.
+A slot is only written while nobody else can reach it: when it is
+created or reused, before being registered in the index, and when it
+is discarded, after its last binding is gone. slot_lock guards the
+positional stack and the growth of the store.
+Locks are always taken in this order: shard, slot_lock.
+
+Deferred releases:
+A thread deferring its releases keeps the number of bindings it
+dropped from each resource without unbinding them. The shared
+reference count of a resource therefore never falls below its actual
+number of bindings, so a resource is never discarded while a binding
+to it may still be in use, only later than it could be. Taking a
+deferred release back for a new binding keeps that true, since both
+numbers then rise together.
 */
 
 
 //a
 
-StringResourceList* StringResourceList::cache = nullptr;
+/*
+Batches hide memory latency by requesting what the string or resource
+PREFETCH_DISTANCE positions further will need while working on the
+current one: its bytes while hashing, its bucket while looking up, and
+its resource while unbinding.
+*/
+constexpr size_t PREFETCH_DISTANCE = 16;
+
+std::atomic<StringResourceList*> StringResourceList::cache = nullptr;
+std::mutex StringResourceList::cache_lock;
+
+struct StringResourceList::ThreadCache {
+	static constexpr size_t SLOTS = 64;
+	static constexpr size_t FLUSH_INTERVAL = 4096;
+
+	struct Slot {
+		resource_t index;
+		size_t pending;
+	};
+
+	Slot slots[SLOTS];
+	size_t deferred;  // releases deferred since the last flush
+
+	ThreadCache() : slots(), deferred(0) {
+		for (Slot& slot : this->slots)
+			slot.index = -1;
+	}
+	~ThreadCache();
+
+	Slot& slotOf(resource_t index) {
+		return this->slots[(size_t)index % SLOTS];
+	}
+};
+
+namespace {
+	thread_local bool defer_releases = false;
+	// set once the cache of the thread is destroyed, after which releases are applied at once.
+	thread_local bool thread_cache_gone = false;
+}
+
+thread_local StringResourceList::ThreadCache StringResourceList::thread_cache;
+
+StringResourceList::ThreadCache::~ThreadCache() {
+	StringResourceList* list = cache.load(std::memory_order_acquire);
+	if (list)
+		list->flushReleases();
+	thread_cache_gone = true;
+}
 
 StringResourceList& StringResourceList::get() {
-	if (!cache) {
-		cache = new StringResourceList();
+	StringResourceList* list = cache.load(std::memory_order_acquire);
+	if (list)
+		return *list;
+	std::lock_guard<std::mutex> guard(cache_lock);
+	list = cache.load(std::memory_order_relaxed);
+	if (!list) {
+		list = new StringResourceList();
+		cache.store(list, std::memory_order_release);
 		atexit(freeCache);
 	}
-	return *cache;
+	return *list;
 }
 
 void StringResourceList::freeCache() {
-	if (cache) {
-		delete cache;
-		cache = nullptr;
+	std::lock_guard<std::mutex> guard(cache_lock);
+	StringResourceList* list = cache.exchange(nullptr);
+	if (list) {
+		delete list;
 	}
 }
 
@@ -45,28 +130,40 @@ resource_t StringResourceList::pop_position() {
 }
 
 StringResourceList::StringResourceList() {
-	this->resources = std::vector<StringResource>();
 	this->positional_stack = std::vector<resource_t>();
 }
 
+StringResourceList::Shard& StringResourceList::shardOf(hash_t hash) {
+	return this->shards[(uint64_t)hash % SHARD_COUNT];
+}
+
 /*
 Create a new string resource by copying the specified data into the list.
 The resource is placed at the end of the list if no slots are available
 in the middle.
+The caller is responsible for registering it in the index.
+*/
+resource_t StringResourceList::createResource(const char* contents, size_t sz, hash_t hash) {
+	return this->placeResource(StringResource::create(this->arena, contents, sz, hash));
+}
+
+/*
+Binds to a resource that was just built and gives it a slot.
+The caller is responsible for registering it in the index.
 */
-resource_t StringResourceList::createResource(const char* contents, size_t sz) {
+resource_t StringResourceList::placeResource(StringResource* res) {
+	res->incref();
+
+	std::lock_guard<std::mutex> slots(this->slot_lock);
 	//std::cout << "Positional stack is first " << this->positional_stack.size() << " long.\n";
 	//std::cout << "Resources is first " << this->resources.size() << " long.\n";
 	if (this->positional_stack.size()) {
 		resource_t position = this->pop_position();
-		this->resources[position] = StringResource(contents, sz);
-		this->resources[position].incref();
+		this->resources[position] = res;
 		return position;
 	}
-	resource_t pos = this->resources.size();
-	this->resources.push_back(StringResource(contents, sz));
+	resource_t pos = this->resources.append(res);
 	//std::cout << "Resources is then " << this->resources.size() << " long.\n";
-	this->resources[pos].incref();
 	return pos;
 }
 
@@ -74,33 +171,127 @@ resource_t StringResourceList::createResource(const char* contents, size_t sz) {
 Delete a string resource and free the space it occupies in the list.
 The now free position is pushed to the positional stack to notify
 the list of its availability.
+The shard owning the resource must be locked by the caller.
 */
-void StringResourceList::discardResource(resource_t index) {
-	this->resources[index].release();
-	this->resources[index] = StringResource();
+void StringResourceList::discardResource(Shard& shard, resource_t index) {
+	StringResource* res = this->resources[index];
+	this->resources[index] = nullptr;
+	shard.index.erase(res->hash(), index);
+	res->release(this->arena);
+	std::lock_guard<std::mutex> slots(this->slot_lock);
 	this->push_position(index);
 }
 
 
 void StringResourceList::decref(resource_t index) {
-	this->resources[index].decref();
-	if (this->resources[index].getRefCnt() == 0) {
-		this->discardResource(index);
+	StringResource* res = this->resources[index];
+	if (res->tryDecref())
+		return;
+	// this may be the last reference, which is only dropped under the shard lock.
+	Shard& shard = this->shardOf(res->hash());
+	std::lock_guard<std::mutex> guard(shard.lock);
+	res->decref();
+	if (res->getRefCnt() == 0) {
+		this->discardResource(shard, index);
 	}
 }
 
-void StringResourceList::incref(resource_t index) {
-	this->resources[index].incref();
+/*
+Counts one more release of the resource, to be applied later.
+*/
+void StringResourceList::deferDecref(resource_t index) {
+	ThreadCache& cache = thread_cache;
+	ThreadCache::Slot& slot = cache.slotOf(index);
+	if (slot.index != index) {
+		if (slot.pending)
+			this->release(slot.index, slot.pending);
+		slot.index = index;
+		slot.pending = 0;
+	}
+	slot.pending++;
+	if (++cache.deferred >= ThreadCache::FLUSH_INTERVAL)
+		this->flushReleases();
 }
 
-resource_t StringResourceList::searchForResource(hash_t hash) {
-	for (resource_t i = 0; i < (long long)this->resources.size(); i++) {
-		if (this->resources[i] && this->resources[i].hash() == hash)
-			return i;
+/*
+Drops count bindings at once. Only the last binding of the resource
+needs its shard to be locked.
+*/
+void StringResourceList::release(resource_t index, size_t count) {
+	StringResource* res = this->resources[index];
+	if (res->tryDecref(count))
+		return;
+	// the count includes ours, so all of them but one can go.
+	if (count > 1)
+		res->tryDecref(count - 1);
+	this->decref(index);
+}
+
+void StringResourceList::deferReleases(bool enabled) {
+	defer_releases = enabled;
+	if (!enabled)
+		get().flushReleases();
+}
+
+void StringResourceList::flushReleases() {
+	if (thread_cache_gone)
+		return;
+	ThreadCache& cache = thread_cache;
+	for (ThreadCache::Slot& slot : cache.slots) {
+		if (slot.pending)
+			this->release(slot.index, slot.pending);
+		slot.index = -1;
+		slot.pending = 0;
+	}
+	cache.deferred = 0;
+}
+
+bool StringResourceList::pin(resource_t index) {
+	if (!this->doesResourceExist(index))
+		return 0;
+	this->resources[index]->pin();
+	return 1;
+}
+
+/*
+The caller must hold either a binding to the resource or the lock
+of its shard.
+*/
+void StringResourceList::incref(resource_t index, size_t count) {
+	this->resources[index]->incref(count);
+}
+
+/*
+The caller must hold the lock of the shard.
+*/
+resource_t StringResourceList::searchForResource(Shard& shard, const char* str, size_t sz, hash_t hash) {
+	size_t cursor = 0;
+	resource_t candidate;
+	while ((candidate = shard.index.next(hash, &cursor)) >= 0) {
+		StringResource* res = this->resources[candidate];
+		if (res->getSize() == sz && !std::memcmp(res->buffer(), str, sz)) {
+			this->incref(candidate);
+			return candidate;
+		}
 	}
 	return -1;
 }
 
+/*
+Binds to the resource holding the specified string, creating and
+registering it if there is none.
+The caller must hold the lock of the shard.
+*/
+resource_t StringResourceList::searchOrCreate(Shard& shard, const char* str, size_t sz, hash_t hash) {
+	resource_t res = this->searchForResource(shard, str, sz, hash);
+	if (res < 0) {
+		//std::cout << "Not found, creating...\n";
+		res = this->createResource(str, sz, hash);
+		shard.index.insert(hash, res);
+	}
+	return res;
+}
+
 bool StringResourceList::doesResourceExist(resource_t index) {
 	if ((long long)this->resources.size() <= index)  // index out of bounds
 		return 0;
@@ -111,47 +302,191 @@ bool StringResourceList::doesResourceExist(resource_t index) {
 	return 1;
 }
 
-resource_t StringResourceList::find(hash_t hash) {
-	resource_t res = this->searchForResource(hash);
-	if (res >= 0) this->incref(res);
-	return res;
+resource_t StringResourceList::find(const char* str, size_t sz) {
+	if (sz && str[sz - 1] == 0)  // a trailing terminator is not part of the string.
+		sz--;
+	hash_t hash = computeHash(str, sz);
+	Shard& shard = this->shardOf(hash);
+	std::lock_guard<std::mutex> guard(shard.lock);
+	return this->searchForResource(shard, str, sz, hash);
 }
 
 resource_t StringResourceList::bind(const char* str, size_t sz) {
-	hash_t hash = computeHash(str, sz);
+	if (sz && str[sz - 1] == 0)
+		sz--;
+	return this->bind(str, sz, computeHash(str, sz));
+}
+
+resource_t StringResourceList::bind(const char* str, size_t sz, hash_t hash) {
 	//std::cout << "Hash is " << hash << "\n";
-	resource_t res = this->find(hash);
-	if (res < 0) {
-		//std::cout << "Not found, creating...\n";
-		res = this->createResource(str, sz);
+	Shard& shard = this->shardOf(hash);
+	std::lock_guard<std::mutex> guard(shard.lock);
+	return this->searchOrCreate(shard, str, sz, hash);
+}
+
+resource_t StringResourceList::bindStatic(StringResource* res) {
+	Shard& shard = this->shardOf(res->hash());
+	std::lock_guard<std::mutex> guard(shard.lock);
+	resource_t index = this->searchForResource(shard, res->buffer(), res->getSize(), res->hash());
+	if (index < 0) {
+		index = this->placeResource(res);
+		shard.index.insert(res->hash(), index);
 	}
+	this->resources[index]->pin();
+	return index;
+}
+
+char* StringResourceList::allocateBuffer(size_t capacity) {
+	return StringResource::contentsOf(StringArena::allocateDetached(StringResource::allocationSize(capacity)));
+}
+
+void StringResourceList::freeBuffer(char* buffer) {
+	if (buffer)
+		StringArena::freeDetached(StringResource::blockOf(buffer));
+}
+
+resource_t StringResourceList::bindBuffer(char** buffer, size_t capacity, size_t sz, hash_t hash) {
+	// resources small enough for a size class are released to it, so their bytes must be
+	// copied into a block of the class. Copying them costs little anyway, and so does
+	// copying a buffer mostly left empty, which would otherwise stay that large for good.
+	if (StringResource::allocationSize(sz) <= StringArena::MAX_SMALL || sz < capacity / 2)
+		return this->bind(*buffer, sz, hash);
+
+	Shard& shard = this->shardOf(hash);
+	std::lock_guard<std::mutex> guard(shard.lock);
+	resource_t res = this->searchForResource(shard, *buffer, sz, hash);
+	if (res >= 0)
+		return res;
+	// the arena frees the block along with the resource from now on.
+	this->arena.attach(StringResource::blockOf(*buffer));
+	res = this->placeResource(StringResource::adopt(StringResource::blockOf(*buffer), sz, hash));
+	shard.index.insert(hash, res);
+	*buffer = nullptr;
 	return res;
 }
 
+void StringResourceList::bindMany(std::span<const std::pair<const char*, size_t>> strs, resource_t* out) {
+	std::vector<std::pair<const char*, size_t>> trimmed(strs.begin(), strs.end());
+	std::vector<hash_t> hashes(strs.size());
+	for (size_t i = 0; i < trimmed.size(); i++) {
+		if (i + PREFETCH_DISTANCE < trimmed.size())
+			prefetchRead(trimmed[i + PREFETCH_DISTANCE].first);
+		if (trimmed[i].second && trimmed[i].first[trimmed[i].second - 1] == 0)
+			trimmed[i].second--;
+		hashes[i] = computeHash(trimmed[i].first, trimmed[i].second);
+	}
+	this->bindMany(trimmed, hashes.data(), out);
+}
+
+void StringResourceList::bindMany(std::span<const std::pair<const char*, size_t>> strs, const hash_t* hashes, resource_t* out) {
+	// counting sort of the strings by shard, so that each shard is visited once.
+	size_t starts[SHARD_COUNT + 1] = {};
+	for (size_t i = 0; i < strs.size(); i++)
+		starts[(uint64_t)hashes[i] % SHARD_COUNT + 1]++;
+	for (size_t s = 0; s < SHARD_COUNT; s++)
+		starts[s + 1] += starts[s];
+	size_t ends[SHARD_COUNT];
+	std::memcpy(ends, starts, sizeof(ends));
+	std::vector<size_t> order(strs.size());
+	for (size_t i = 0; i < strs.size(); i++)
+		order[ends[(uint64_t)hashes[i] % SHARD_COUNT]++] = i;
+
+	for (size_t s = 0; s < SHARD_COUNT; s++) {
+		if (starts[s] == starts[s + 1])
+			continue;
+		Shard& shard = this->shards[s];
+		std::lock_guard<std::mutex> guard(shard.lock);
+		for (size_t k = starts[s]; k < starts[s + 1]; k++) {
+			if (k + PREFETCH_DISTANCE < starts[s + 1])
+				shard.index.prefetch(hashes[order[k + PREFETCH_DISTANCE]]);
+			size_t i = order[k];
+			out[i] = this->searchOrCreate(shard, strs[i].first, strs[i].second, hashes[i]);
+		}
+	}
+}
+
 resource_t StringResourceList::bind(resource_t index) {
 	if (!this->doesResourceExist(index))
 		return -1;
 	//std::cout << "here\n";
+	if (defer_releases && !thread_cache_gone) {
+		ThreadCache::Slot& slot = thread_cache.slotOf(index);
+		if (slot.index == index && slot.pending) {
+			slot.pending--;
+			return index;
+		}
+	}
 	this->incref(index);
 	return index;
 }
 
+resource_t StringResourceList::bind(resource_t index, size_t count) {
+	if (!this->doesResourceExist(index))
+		return -1;
+	this->incref(index, count);
+	return index;
+}
+
 bool StringResourceList::unbind(resource_t* pindex) {
 	if (!pindex)
 		return 0;
 	if (!this->doesResourceExist(*pindex))
 		return 0;
-	this->decref(*pindex);
+	if (defer_releases && !thread_cache_gone)
+		this->deferDecref(*pindex);
+	else
+		this->decref(*pindex);
 	*pindex = -1;
 	return 1;
 }
 
+void StringResourceList::unbindMany(std::span<resource_t> indices) {
+	// bindings that may be the last of their resource, dropped below under the shard lock.
+	std::vector<resource_t> last;
+	for (size_t k = 0; k < indices.size(); k++) {
+		if (k + PREFETCH_DISTANCE < indices.size() && this->doesResourceExist(indices[k + PREFETCH_DISTANCE]))
+			prefetchRead(this->resources[indices[k + PREFETCH_DISTANCE]]);
+		resource_t& index = indices[k];
+		if (!this->doesResourceExist(index))
+			continue;
+		if (!this->resources[index]->tryDecref())
+			last.push_back(index);
+		index = -1;
+	}
+	if (last.empty())
+		return;
+
+	size_t starts[SHARD_COUNT + 1] = {};
+	for (resource_t index : last)
+		starts[(uint64_t)this->resources[index]->hash() % SHARD_COUNT + 1]++;
+	for (size_t s = 0; s < SHARD_COUNT; s++)
+		starts[s + 1] += starts[s];
+	size_t ends[SHARD_COUNT];
+	std::memcpy(ends, starts, sizeof(ends));
+	std::vector<resource_t> order(last.size());
+	for (resource_t index : last)
+		order[ends[(uint64_t)this->resources[index]->hash() % SHARD_COUNT]++] = index;
+
+	for (size_t s = 0; s < SHARD_COUNT; s++) {
+		if (starts[s] == starts[s + 1])
+			continue;
+		Shard& shard = this->shards[s];
+		std::lock_guard<std::mutex> guard(shard.lock);
+		for (size_t k = starts[s]; k < starts[s + 1]; k++) {
+			StringResource* res = this->resources[order[k]];
+			res->decref();
+			if (res->getRefCnt() == 0)
+				this->discardResource(shard, order[k]);
+		}
+	}
+}
+
 bool StringResourceList::get(resource_t index, size_t pos, char* out) {
 	if (!this->doesResourceExist(index))
 		return 0;
 	if (!out)
 		return 0;
-	int16_t res = this->resources[index].getChar(pos);
+	int16_t res = this->resources[index]->getChar(pos);
 	if (res >= CHAR_MAX + 1)
 		return 0;
 	*out = (char)res;
@@ -161,7 +496,7 @@ bool StringResourceList::get(resource_t index, size_t pos, char* out) {
 size_t StringResourceList::size(resource_t index) {
 	if (!this->doesResourceExist(index))
 		return 0;
-	return this->resources[index].getSize();
+	return this->resources[index]->getSize();
 }
 
 
@@ -170,28 +505,47 @@ bool StringResourceList::copy(resource_t index, char* dst) {
 		return 0;
 	if (!dst)
 		return 0;
-	for (size_t i = 0; i < this->size(index); i++) {
-		char c;
-		if (this->get(index, i, &c)) {
-			dst[i] = c;
-		}
-	}
-	dst[this->size(index)] = 0;
+	StringResource* res = this->resources[index];
+	std::memcpy(dst, res->buffer(), res->getSize() + 1);  // terminator included
 	return 1;
 }
 
+bool StringResourceList::copy(resource_t index, size_t offset, size_t len, char* dst) {
+	if (!this->doesResourceExist(index))
+		return 0;
+	if (!dst)
+		return 0;
+	StringResource* res = this->resources[index];
+	if (offset > res->getSize() || len > res->getSize() - offset)
+		return 0;
+	std::memcpy(dst, res->buffer() + offset, len);
+	return 1;
+}
+
+std::span<const char> StringResourceList::span(resource_t index) {
+	if (!this->doesResourceExist(index))
+		return std::span<const char>();
+	StringResource* res = this->resources[index];
+	return std::span<const char>(res->buffer(), res->getSize());
+}
+
 bool StringResourceList::hash(resource_t index, hash_t* out) {
 	if (!this->doesResourceExist(index))
 		return 0;
 	if (!out)
 		return 0;
-	*out = this->resources[index].hash();
+	*out = this->resources[index]->hash();
 	return 1;
 }
 
 const char* StringResourceList::buffer(resource_t index) {
 	if (!this->doesResourceExist(index))
 		return nullptr;
-	return this->resources[index].buffer();
+	return this->resources[index]->buffer();
 }
 
+StringArenaStats StringResourceList::memoryStats() {
+	if (defer_releases)
+		this->flushReleases();
+	return this->arena.stats();
+}
@@ -1,6 +1,13 @@
 #pragma once
+#include "StringArena.hpp"
 #include "StringResource.hpp"
+#include "StringResourceIndex.hpp"
+#include "StringResourceStore.hpp"
 #include "resource.hpp"
+#include <atomic>
+#include <mutex>
+#include <span>
+#include <utility>
 #include <vector>
 
 /*
@@ -16,22 +23,55 @@ String resources stored here are read-only.
 If a string resource's number of bindings reaches zero,
 it is deleted. This gives more space for future resources
 without the need to push_back the list of resources again.
-Strings are compared using their hash values.
+Resources are looked up through a hash index that maps each
+hash to the slots holding it; a candidate only matches once
+its bytes compare equal to the searched string. Two resources
+never hold the same string, even if their hashes collide, so
+two strings bound to whole resources are equal exactly when their
+indices are. Slices cover part of a resource, and are compared by
+their bytes.
+Every member function may be called from any thread.
 */
 class StringResourceList
 {
-	static StringResourceList* cache;
-	std::vector<StringResource> resources;
+	static constexpr size_t SHARD_COUNT = 64;
+
+	/*
+	A slice of the hash index, covering the hashes that are equal
+	modulo SHARD_COUNT, along with the lock that guards it.
+	*/
+	struct Shard {
+		std::mutex lock;
+		StringResourceIndex index;
+	};
+
+	/*
+	Releases deferred by a thread, kept until they are flushed.
+	*/
+	struct ThreadCache;
+	static thread_local ThreadCache thread_cache;
+
+	static std::atomic<StringResourceList*> cache;
+	static std::mutex cache_lock;
+	StringArena arena;
+	StringResourceStore resources;
 	std::vector<resource_t> positional_stack;
+	Shard shards[SHARD_COUNT];
+	std::mutex slot_lock;
 
 	resource_t pop_position();
 	void push_position(resource_t);
-	resource_t createResource(const char*, size_t);
-	void discardResource(resource_t);
-	resource_t searchForResource(hash_t);
+	Shard& shardOf(hash_t);
+	resource_t createResource(const char*, size_t, hash_t);
+	resource_t placeResource(StringResource*);
+	void discardResource(Shard&, resource_t);
+	resource_t searchForResource(Shard&, const char*, size_t, hash_t);
+	resource_t searchOrCreate(Shard&, const char*, size_t, hash_t);
 
-	void incref(resource_t);
+	void incref(resource_t, size_t count = 1);
 	void decref(resource_t);
+	void deferDecref(resource_t);
+	void release(resource_t, size_t count);
 
 	StringResourceList();
 	bool doesResourceExist(resource_t);
@@ -44,12 +84,12 @@ public:
 	static StringResourceList& get();
 
 	/*
-	Searches for a resource with the specified hash and
-	returns the index that uniquely identifies it.
+	Searches for a resource holding exactly the specified string
+	and returns the index that uniquely identifies it.
 	Returns -1 if the resource is not found.
 	Note: this function does perform a binding operation.
 	*/
-	resource_t find(hash_t hash);
+	resource_t find(const char* str, size_t sz);
 	/*
 	Tries to bind to an existing string resource.
 	If the resource is not found, create a new resource
@@ -58,11 +98,65 @@ public:
 	*/
 	resource_t bind(const char* str, size_t sz);
 	/*
+	Same as bind(str, sz), except that the hash of the string was
+	already computed by the caller, e.g. by combining the hashes of
+	its parts. The string is taken as is, trailing zero included.
+	*/
+	resource_t bind(const char* str, size_t sz, hash_t hash);
+	/*
+	Binds to each of the strings of strs, like bind(str, sz) would,
+	and stores the resulting indices at the same positions in out.
+	Every string is hashed before any lock is taken. The strings are
+	then grouped by shard, so each shard is locked at most once for
+	the whole batch.
+	*/
+	void bindMany(std::span<const std::pair<const char*, size_t>> strs, resource_t* out);
+	/*
+	Same as bindMany(strs, out), with the hash of each string already
+	computed by the caller. The strings are taken as is.
+	*/
+	void bindMany(std::span<const std::pair<const char*, size_t>> strs, const hash_t* hashes, resource_t* out);
+	/*
+	Allocates a buffer of capacity bytes, plus one for a terminator,
+	that bindBuffer can turn into a resource without copying it.
+	The buffer is detached from the arena until then, so neither
+	function reaches the list, and a buffer may outlive it.
+	*/
+	static char* allocateBuffer(size_t capacity);
+	/*
+	Frees a buffer obtained from allocateBuffer, which records its own
+	capacity.
+	*/
+	static void freeBuffer(char* buffer);
+	/*
+	Binds to the string held by the first sz bytes of *buffer, whose
+	hash was already computed by the caller, like bind(str, sz, hash)
+	would. *buffer must come from allocateBuffer with the specified
+	capacity. If a new resource is needed and the buffer is large and
+	full enough, the buffer becomes that resource: *buffer is then set
+	to nullptr and must not be freed. Otherwise the buffer is left to
+	the caller.
+	*/
+	resource_t bindBuffer(char** buffer, size_t capacity, size_t sz, hash_t hash);
+	/*
+	Binds to the string of res, a resource built by the caller in
+	storage that outlives the list, e.g. a static variable, through
+	StringResource::adopt. If another resource already holds that
+	string, that one is bound instead. Either way the resource bound
+	is pinned, so res is never released.
+	*/
+	resource_t bindStatic(StringResource* res);
+	/*
 	Binds to the resource identified by index.
 	Returns index on success, -1 otherwise.
 	*/
 	resource_t bind(resource_t index);
 	/*
+	Binds count times at once to the resource identified by index.
+	Returns index on success, -1 otherwise.
+	*/
+	resource_t bind(resource_t index, size_t count);
+	/*
 	Unbinds from the resource identified by *pindex.
 	Sets *pindex to -1.
 	If *pindex is invalid, its value is unaffected.
@@ -70,6 +164,38 @@ public:
 	*/
 	bool unbind(resource_t* pindex);
 
+	/*
+	Makes the calling thread defer the release of its bindings, or
+	stop doing so, in which case the deferred releases are applied.
+	Deferred releases are kept in a small table local to the thread,
+	and a later binding to the same resource by the same thread takes
+	one of them back instead of raising the shared reference count,
+	so strings copied and destroyed over and over never write to it.
+	Resources are discarded once every deferred release of them was
+	applied: when the table is full, after every FLUSH_INTERVAL
+	releases, on flushReleases, and when the thread exits.
+	*/
+	static void deferReleases(bool enabled);
+	/*
+	Applies every release deferred by the calling thread.
+	*/
+	void flushReleases();
+	/*
+	Pins the resource identified by index, which is then never
+	discarded and whose reference count is never written to again.
+	Returns whether the resource exists.
+	*/
+	bool pin(resource_t index);
+
+	/*
+	Unbinds from every resource of indices, like unbind would, and
+	sets the entries that were unbound to -1.
+	Bindings that are not the last one of their resource are dropped
+	without locking. The last ones are grouped by shard, so each shard
+	is locked at most once for the whole batch.
+	*/
+	void unbindMany(std::span<resource_t> indices);
+
 	/*
 	Fills *out with the character at the specified position
 	in the string resource identified by index.
@@ -94,6 +220,20 @@ public:
 	*/
 	bool copy(resource_t index, char* dst);
 	/*
+	Copies len bytes of the string resource identified by index,
+	starting at offset, into the specified destination buffer. No
+	terminator is written.
+	Returns 0 if the resource doesn't exist or if the range doesn't
+	fit inside it, in which case nothing is copied.
+	*/
+	bool copy(resource_t index, size_t offset, size_t len, char* dst);
+	/*
+	Returns the contents of the string resource identified by index,
+	terminator excluded, or an empty span if the resource doesn't
+	exist. The span stays valid as long as the resource is bound.
+	*/
+	std::span<const char> span(resource_t index);
+	/*
 	Fills *out with the hash value of the string resource identified
 	by index, if it exists.
 	Returns 1 on success, 0 otherwise.
@@ -104,6 +244,12 @@ public:
 	by index. Returns nullptr is the resource is not found.
 	*/
 	const char* buffer(resource_t index);
+	/*
+	Returns the occupancy of the arena that holds the contents of
+	every string resource, which tells how much memory interned
+	strings take and how fragmented it is.
+	*/
+	StringArenaStats memoryStats();
 
 	StringResourceList(const StringResourceList&) = delete;
 	StringResourceList& operator =(const StringResourceList&) = delete;
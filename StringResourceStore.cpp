@@ -0,0 +1,49 @@
+#include "StringResourceStore.hpp"
+#include <new>
+
+/*
+A slot becomes visible to readers once count is raised past its index.
+Its page is published before that, and count is written with release
+semantics, so a reader that checked the index against size() always
+finds both the page and the slot initialized.
+*/
+
+StringResourceStore::StringResourceStore() :
+	pages(new std::atomic<StringResource**>[MAX_PAGES]()), count(0)
+{}
+
+StringResourceStore::~StringResourceStore() {
+	for (size_t i = 0; i < MAX_PAGES; i++) {
+		StringResource** page = this->pages[i].load(std::memory_order_relaxed);
+		if (!page)
+			break;
+		delete[] page;
+	}
+	delete[] this->pages;
+}
+
+StringResource*& StringResourceStore::operator[](resource_t index) {
+	size_t i = (size_t)index;
+	StringResource** page = this->pages[i >> PAGE_BITS].load(std::memory_order_acquire);
+	return page[i & (PAGE_SIZE - 1)];
+}
+
+size_t StringResourceStore::size() const {
+	return this->count.load(std::memory_order_acquire);
+}
+
+resource_t StringResourceStore::append(StringResource* res) {
+	size_t i = this->count.load(std::memory_order_relaxed);
+	size_t page_index = i >> PAGE_BITS;
+	if (page_index >= MAX_PAGES)
+		throw std::bad_alloc();
+	StringResource** page = this->pages[page_index].load(std::memory_order_relaxed);
+	if (!page) {
+		page = new StringResource*[PAGE_SIZE]();
+		this->pages[page_index].store(page, std::memory_order_release);
+	}
+	page[i & (PAGE_SIZE - 1)] = res;
+	this->count.store(i + 1, std::memory_order_release);
+	return (resource_t)i;
+}
+
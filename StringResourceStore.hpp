@@ -0,0 +1,51 @@
+#pragma once
+#include "StringResource.hpp"
+#include "resource.hpp"
+#include <atomic>
+#include <cstddef>
+
+/*
+Segmented storage for the slots of a StringResourceList.
+Each slot points to the resource occupying it, or is null if blank.
+Slots live in fixed-size pages that are allocated on demand and never
+move or get copied afterwards, so a reference to a slot stays valid
+however much the store grows.
+Pages are reached through a fixed directory, which lets any thread
+read a slot without locking while another one appends.
+*/
+class StringResourceStore
+{
+public:
+	static constexpr size_t PAGE_BITS = 12;
+	static constexpr size_t PAGE_SIZE = (size_t)1 << PAGE_BITS;
+	static constexpr size_t MAX_PAGES = (size_t)1 << 16;
+
+private:
+	std::atomic<StringResource**>* pages;
+	std::atomic<size_t> count;
+
+public:
+	StringResourceStore();
+	~StringResourceStore();
+
+	/*
+	Returns the slot at the specified index, which must be lower
+	than size().
+	*/
+	StringResource*& operator [](resource_t index);
+	/*
+	Returns the number of slots handed out so far.
+	*/
+	size_t size() const;
+	/*
+	Stores res in a new slot at the end of the store and returns
+	its index. Calls to append must not run concurrently with one
+	another, but may run concurrently with any other member function.
+	Throws std::bad_alloc once MAX_PAGES pages are in use.
+	*/
+	resource_t append(StringResource* res);
+
+	StringResourceStore(const StringResourceStore&) = delete;
+	StringResourceStore& operator =(const StringResourceStore&) = delete;
+};
+
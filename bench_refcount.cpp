@@ -0,0 +1,84 @@
+#include "string.hpp"
+#include "StringResource.hpp"
+#include "stringbuilder.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#ifndef STRLIB_COUNT_REFS
+#error "bench_refcount.cpp needs the library built with STRLIB_COUNT_REFS defined"
+#endif
+
+/*
+Counts the writes made to reference counts by common operations of
+the string API, which should make none unless they produce a string
+of their own. Each operation runs many times, and the benchmark prints
+the average number of writes and time per run. A plain copy, which
+binds and releases once, is shown for reference, along with a copy
+made with releases deferred.
+The whole library must be built with STRLIB_COUNT_REFS defined, along
+with this file and without strlib0.2.cpp, e.g.
+	g++ -std=c++20 -O2 -pthread -DSTRLIB_COUNT_REFS bench_refcount.cpp <library sources>
+*/
+
+namespace {
+
+	constexpr int RUNS = 1000000;
+
+	long long total = 0;
+
+	template <typename F>
+	void run(const char* name, F operation) {
+		size_t writes = StringResource::refCountWrites();
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < RUNS; i++)
+			total += operation(i);
+		double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		std::printf("%-28s %5.2f writes/op %8.1f ns/op\n", name,
+			(double)(StringResource::refCountWrites() - writes) / RUNS, ns / RUNS);
+	}
+
+	size_t byReference(const string& str) {
+		return str.length();
+	}
+
+}
+
+
+int main() {
+	string hay("the quick brown fox jumps over the lazy dog");
+	string prefix("the quick");
+	std::vector<string> keys;
+	for (int i = 0; i < 1000; i++)
+		keys.push_back(string(("key number " + std::to_string(i)).c_str()));
+	std::vector<string> parts(keys.begin(), keys.begin() + 8);
+	string separator(", ");
+	string empty("");
+
+	run("copy", [&](int i) { string copy = keys[i % 1000]; return (long long)copy.length(); });
+	run("pass by reference", [&](int i) { return (long long)byReference(keys[i % 1000]); });
+	run("operator ==", [&](int i) { return (long long)(keys[i % 1000] == keys[i * 7 % 1000]); });
+	run("operator == string_view", [&](int i) { return (long long)(keys[i % 1000] == std::string_view("key number 5")); });
+	run("startsWith", [&](int) { return (long long)hay.startsWith(prefix); });
+	run("contains", [&](int) { return (long long)hay.contains("lazy dog"); });
+	run("operator + empty", [&](int i) { return (long long)(keys[i % 1000] + empty).length(); });
+	run("removePrefix().substring()", [&](int) { return (long long)hay.removePrefix(prefix).substring(1, 20).length(); });
+	run("split", [&](int i) { return i % 100 ? 0 : (long long)hay.split(" ").size(); });
+	run("join", [&](int i) { return i % 100 ? 0 : (long long)separator.join(parts).length(); });
+	run("stringbuilder append", [&](int i) {
+		stringbuilder builder;
+		builder.append(keys[i % 1000]);
+		builder.append(hay);
+		return (long long)builder.length();
+	});
+
+	// deferring releases pays off when the same strings are copied over and over.
+	run("copy of one string", [&](int) { string copy = hay; return (long long)copy.length(); });
+	string::deferReleases(true);
+	run("same, releases deferred", [&](int) { string copy = hay; return (long long)copy.length(); });
+	string::deferReleases(false);
+
+	std::fprintf(stderr, "%lld\n", total);
+	return 0;
+}
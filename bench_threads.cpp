@@ -0,0 +1,119 @@
+#include "string.hpp"
+#include "StringResourceList.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+Multithreaded stress benchmark of the list of string resources.
+Each workload runs on 1, 2, 4... threads, up to the number of cores
+(at least 8), and prints its total throughput along with the speedup
+over a single thread. A list that scales keeps the speedup close to
+the number of threads, up to the number of cores.
+- intern: strings are built from a pool of keys, most of them shared
+  by every thread, then copied, compared and destroyed, with some of
+  them kept for a while. This reaches the shards of the hash index.
+- copy: every thread copies and destroys the same string, which only
+  reaches its reference count, once as is, once with releases
+  deferred, and once with the string pinned.
+The benchmark fails if any memory is left to the arena once every
+string is gone, or if a string comes out with the wrong contents.
+It is built on its own, with every source of the library except
+strlib0.2.cpp, e.g.
+	g++ -std=c++20 -O2 -pthread bench_threads.cpp <library sources>
+The number of operations per thread can be passed as argument.
+*/
+
+namespace {
+
+	std::vector<std::string> keys;
+
+	void fail(const char* what) {
+		std::fprintf(stderr, "bench_threads: %s\n", what);
+		std::exit(1);
+	}
+
+	void intern(unsigned thread, size_t count) {
+		std::vector<string> held;
+		for (size_t i = 0; i < count; i++) {
+			// one key out of 8 is only used by this thread.
+			std::string own;
+			const std::string* key = &keys[(i * 7 + thread * 13) % keys.size()];
+			if (i % 8 == 0) {
+				own = *key + "-" + std::to_string(thread);
+				key = &own;
+			}
+			string str(key->data(), key->size());
+			string copy = str;
+			if (copy != string(key->data(), key->size()) || copy.length() != key->size())
+				fail("wrong contents");
+			if (i % 5 == 0)
+				held.push_back(copy);
+			if (held.size() > 64)
+				held.erase(held.begin(), held.begin() + 32);
+		}
+	}
+
+	void copy(const string& hot, bool defer, size_t count) {
+		if (defer)
+			string::deferReleases(true);
+		size_t sum = 0;
+		for (size_t i = 0; i < count; i++) {
+			string copy = hot;
+			sum += copy.view()[i % 8];
+		}
+		if (defer)
+			string::deferReleases(false);
+		if (!sum)
+			fail("wrong contents");
+	}
+
+	template <typename F>
+	void run(const char* name, size_t count, F work) {
+		unsigned cores = std::max(std::thread::hardware_concurrency(), 1u);
+		double single = 0;
+		for (unsigned threads = 1; threads <= std::max(cores, 8u); threads *= 2) {
+			auto start = std::chrono::steady_clock::now();
+			std::vector<std::thread> pool;
+			for (unsigned t = 0; t < threads; t++)
+				pool.emplace_back(work, t, count);
+			for (std::thread& t : pool)
+				t.join();
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			double ops = (double)threads * (double)count / seconds / 1e6;
+			if (threads == 1)
+				single = ops;
+			std::printf("%-16s %3u threads: %8.2f Mops/s, x%.2f\n", name, threads, ops, ops / single);
+		}
+	}
+
+}
+
+
+int main(int argc, char** argv) {
+	size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 400000;
+	for (int i = 0; i < 4096; i++)
+		keys.push_back("header-" + std::to_string(i % 1024) + (i % 3 ? "-x" : "-yy"));
+	std::printf("%u cores\n", std::thread::hardware_concurrency());
+
+	StringResourceList& list = StringResourceList::get();
+	size_t requested = list.memoryStats().requested;
+
+	run("intern", count, intern);
+	{
+		string hot("Content-Type: application/json");
+		run("copy", count, [&](unsigned, size_t n) { copy(hot, 0, n); });
+		run("copy deferred", count, [&](unsigned, size_t n) { copy(hot, 1, n); });
+	}
+	if (list.memoryStats().requested != requested)
+		fail("memory left to the arena");
+
+	string pinned("Content-Type: text/plain; charset=utf-8");
+	pinned.pin();
+	run("copy pinned", count, [&](unsigned, size_t n) { copy(pinned, 0, n); });
+	return 0;
+}
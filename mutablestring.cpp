@@ -0,0 +1,308 @@
+#include "mutablestring.hpp"
+#include "StringResourceList.hpp"
+#include "strsearch.h"
+#include "StringIndexOutOfBoundsException.hpp"
+#include <cstring>
+#include <utility>
+
+
+mutablestring::mutablestring() :
+	buffer(local), count(0), capacity(INLINE_CAPACITY), local()
+{}
+
+mutablestring::mutablestring(const char* str, size_t sz) : mutablestring() {
+	this->append(str, sz);
+}
+
+mutablestring::mutablestring(const char* str) : mutablestring(str, std::strlen(str))
+{}
+
+mutablestring::mutablestring(const string& str) : mutablestring(str.view())
+{}
+
+mutablestring::mutablestring(std::string_view str) : mutablestring() {
+	this->append(str);
+}
+
+mutablestring::mutablestring(const mutablestring& src) : mutablestring() {
+	this->append(src.buffer, src.count);
+}
+
+mutablestring::mutablestring(mutablestring&& src) noexcept : mutablestring() {
+	this->takeFrom(src);
+}
+
+mutablestring& mutablestring::operator=(const mutablestring& src) {
+	if (this == &src)
+		return *this;
+	this->clear();
+	return this->append(src.buffer, src.count);
+}
+
+mutablestring& mutablestring::operator=(mutablestring&& src) noexcept {
+	if (this == &src)
+		return *this;
+	if (!this->isInline())
+		StringResourceList::freeBuffer(this->buffer);
+	this->buffer = this->local;
+	this->capacity = INLINE_CAPACITY;
+	this->takeFrom(src);
+	return *this;
+}
+
+mutablestring::~mutablestring() {
+	if (!this->isInline())
+		StringResourceList::freeBuffer(this->buffer);
+}
+
+bool mutablestring::isInline() const {
+	return this->buffer == this->local;
+}
+
+/*
+Takes the contents of src, which is left empty. This string must be
+inline.
+*/
+void mutablestring::takeFrom(mutablestring& src) {
+	this->count = src.count;
+	if (src.isInline()) {
+		std::memcpy(this->local, src.local, src.count + 1);
+	} else {
+		this->buffer = src.buffer;
+		this->capacity = src.capacity;
+		src.buffer = src.local;
+		src.capacity = INLINE_CAPACITY;
+	}
+	src.count = 0;
+	src.local[0] = 0;
+}
+
+void mutablestring::grow(size_t min_capacity) {
+	size_t new_capacity = this->capacity + this->capacity / 2;
+	if (new_capacity < min_capacity)
+		new_capacity = min_capacity;
+	char* new_buffer = StringResourceList::allocateBuffer(new_capacity);
+	std::memcpy(new_buffer, this->buffer, this->count + 1);
+	if (!this->isInline())
+		StringResourceList::freeBuffer(this->buffer);
+	this->buffer = new_buffer;
+	this->capacity = new_capacity;
+}
+
+char* mutablestring::open(size_t offset, size_t sz) {
+	if (this->capacity - this->count < sz)
+		this->grow(this->count + sz);
+	std::memmove(this->buffer + offset + sz, this->buffer + offset, this->count - offset + 1);
+	this->count += sz;
+	return this->buffer + offset;
+}
+
+mutablestring& mutablestring::append(const string& str) {
+	return this->append(str.view());
+}
+
+mutablestring& mutablestring::append(std::string_view str) {
+	return this->append(str.data(), str.size());
+}
+
+mutablestring& mutablestring::append(const char* str) {
+	return this->append(str, std::strlen(str));
+}
+
+mutablestring& mutablestring::append(const char* str, size_t sz) {
+	if (!sz)
+		return *this;
+	if (this->capacity - this->count < sz) {
+		// str may point into the buffer that growing frees.
+		bool inside = str >= this->buffer && str < this->buffer + this->count;
+		size_t position = inside ? (size_t)(str - this->buffer) : 0;
+		this->grow(this->count + sz);
+		if (inside)
+			str = this->buffer + position;
+	}
+	std::memcpy(this->buffer + this->count, str, sz);
+	this->count += sz;
+	this->buffer[this->count] = 0;
+	return *this;
+}
+
+mutablestring& mutablestring::append(char c) {
+	if (this->count == this->capacity)
+		this->grow(this->count + 1);
+	this->buffer[this->count++] = c;
+	this->buffer[this->count] = 0;
+	return *this;
+}
+
+mutablestring& mutablestring::operator+=(const string& str) {
+	return this->append(str);
+}
+
+mutablestring& mutablestring::operator+=(std::string_view str) {
+	return this->append(str);
+}
+
+mutablestring& mutablestring::operator+=(const char* str) {
+	return this->append(str);
+}
+
+mutablestring& mutablestring::operator+=(char c) {
+	return this->append(c);
+}
+
+mutablestring& mutablestring::insert(size_t offset, std::string_view str) {
+	if (offset > this->count)
+		throw StringIndexOutOfBoundsException("Index out of bounds.");
+	std::memcpy(this->open(offset, str.size()), str.data(), str.size());
+	return *this;
+}
+
+mutablestring& mutablestring::erase(size_t offset, size_t count) {
+	if (offset > this->count)
+		throw StringIndexOutOfBoundsException("Index out of bounds.");
+	if (count > this->count - offset)
+		count = this->count - offset;
+	std::memmove(this->buffer + offset, this->buffer + offset + count, this->count - offset - count + 1);
+	this->count -= count;
+	return *this;
+}
+
+mutablestring& mutablestring::replace(size_t offset, size_t count, std::string_view str) {
+	if (offset > this->count)
+		throw StringIndexOutOfBoundsException("Index out of bounds.");
+	if (count > this->count - offset)
+		count = this->count - offset;
+	if (str.size() > count) {
+		this->open(offset + count, str.size() - count);
+	} else {
+		this->erase(offset + str.size(), count - str.size());
+	}
+	std::memcpy(this->buffer + offset, str.data(), str.size());
+	return *this;
+}
+
+size_t mutablestring::replaceAll(std::string_view from, std::string_view to) {
+	if (from.empty())
+		return 0;
+	size_t replaced = 0;
+	size_t read = 0;
+
+	if (to.size() <= from.size()) {
+		// the result never gets ahead of the contents left to read, so it is written over them.
+		size_t write = 0;
+		for (;;) {
+			size_t found = findSubstring(this->buffer + read, this->count - read, from.data(), from.size());
+			size_t until = found == SEARCH_NOT_FOUND ? this->count : read + found;
+			std::memmove(this->buffer + write, this->buffer + read, until - read);
+			write += until - read;
+			if (found == SEARCH_NOT_FOUND)
+				break;
+			std::memcpy(this->buffer + write, to.data(), to.size());
+			write += to.size();
+			read = until + from.size();
+			replaced++;
+		}
+		this->count = write;
+		this->buffer[write] = 0;
+		return replaced;
+	}
+
+	mutablestring res;
+	res.reserve(this->count);
+	for (;;) {
+		size_t found = findSubstring(this->buffer + read, this->count - read, from.data(), from.size());
+		size_t until = found == SEARCH_NOT_FOUND ? this->count : read + found;
+		res.append(this->buffer + read, until - read);
+		if (found == SEARCH_NOT_FOUND)
+			break;
+		res.append(to.data(), to.size());
+		read = until + from.size();
+		replaced++;
+	}
+	if (replaced)
+		*this = std::move(res);
+	return replaced;
+}
+
+mutablestring& mutablestring::toUpper() {
+	for (size_t i = 0; i < this->count; i++) {
+		char c = this->buffer[i];
+		this->buffer[i] = c >= 'a' && c <= 'z' ? c - ('a' - 'A') : c;
+	}
+	return *this;
+}
+
+mutablestring& mutablestring::toLower() {
+	for (size_t i = 0; i < this->count; i++) {
+		char c = this->buffer[i];
+		this->buffer[i] = c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+	}
+	return *this;
+}
+
+char& mutablestring::operator[](size_t i) {
+	if (i >= this->count)
+		throw StringIndexOutOfBoundsException("Index out of bounds.");
+	return this->buffer[i];
+}
+
+char mutablestring::operator[](size_t i) const {
+	if (i >= this->count)
+		throw StringIndexOutOfBoundsException("Index out of bounds.");
+	return this->buffer[i];
+}
+
+void mutablestring::reserve(size_t capacity) {
+	if (capacity > this->capacity)
+		this->grow(capacity);
+}
+
+void mutablestring::clear() {
+	this->count = 0;
+	this->buffer[0] = 0;
+}
+
+size_t mutablestring::length() const {
+	return this->count;
+}
+
+const char* mutablestring::c_str() const {
+	return this->buffer;
+}
+
+std::string_view mutablestring::view() const {
+	return std::string_view(this->buffer, this->count);
+}
+
+mutablestring::operator std::string_view() const {
+	return this->view();
+}
+
+string mutablestring::freeze() {
+	char* frozen = this->buffer;
+	string res = string::fromBuffer(&frozen, this->isInline() ? 0 : this->capacity, this->count);
+	if (!frozen) {
+		// the buffer now belongs to the resource of res.
+		this->buffer = this->local;
+		this->capacity = INLINE_CAPACITY;
+	}
+	this->clear();
+	return res;
+}
+
+char* mutablestring::begin() {
+	return this->buffer;
+}
+
+char* mutablestring::end() {
+	return this->buffer + this->count;
+}
+
+const char* mutablestring::begin() const {
+	return this->buffer;
+}
+
+const char* mutablestring::end() const {
+	return this->buffer + this->count;
+}
+
@@ -0,0 +1,122 @@
+#pragma once
+#include "string.hpp"
+#include <cstddef>
+#include <string_view>
+
+/*
+String whose contents can be edited in place. Unlike string, it is
+not interned: each mutablestring owns its own buffer, and editing it
+never reaches the list of string resources.
+Contents of up to INLINE_CAPACITY bytes are stored in the object
+itself. Longer ones go to a heap buffer that grows geometrically and
+is laid out so that it can become a string resource as is: freeze()
+interns the contents, and gives the buffer away to the arena instead
+of copying it when they are new and large.
+The contents are always followed by a terminating zero.
+Edits take the bytes to write as a std::string_view, so that strings,
+literals and other buffers are all written without being interned.
+Except for append, the view must not point into this mutablestring.
+*/
+class mutablestring
+{
+	static constexpr size_t INLINE_CAPACITY = 23;
+
+	char* buffer;  // either local or a buffer of the StringResourceList
+	size_t count;
+	size_t capacity;
+	char local[INLINE_CAPACITY + 1];
+
+	bool isInline() const;
+	void grow(size_t min_capacity);
+	void takeFrom(mutablestring&);
+	// makes room for sz bytes at offset, moving the ones after it.
+	char* open(size_t offset, size_t sz);
+
+public:
+	mutablestring();
+	mutablestring(const char*, size_t);
+	mutablestring(const char*);
+	explicit mutablestring(const string&);
+	explicit mutablestring(std::string_view);
+
+	mutablestring(const mutablestring&);
+	mutablestring(mutablestring&&) noexcept;
+	mutablestring& operator =(const mutablestring&);
+	mutablestring& operator =(mutablestring&&) noexcept;
+	~mutablestring();
+
+	/*
+	Take the same pieces, with the same overloads, as
+	stringbuilder::append.
+	*/
+	mutablestring& append(const string&);
+	mutablestring& append(std::string_view);
+	mutablestring& append(const char*);
+	mutablestring& append(const char*, size_t);
+	mutablestring& append(char);
+	mutablestring& operator +=(const string&);
+	mutablestring& operator +=(std::string_view);
+	mutablestring& operator +=(const char*);
+	mutablestring& operator +=(char);
+
+	/*
+	Inserts str before the byte at offset, which may be the length of
+	the string. Throws StringIndexOutOfBoundsException past that.
+	*/
+	mutablestring& insert(size_t offset, std::string_view str);
+	/*
+	Removes up to count bytes starting at offset. Throws
+	StringIndexOutOfBoundsException if offset is past the end.
+	*/
+	mutablestring& erase(size_t offset, size_t count);
+	/*
+	Replaces up to count bytes starting at offset with str. Throws
+	StringIndexOutOfBoundsException if offset is past the end.
+	*/
+	mutablestring& replace(size_t offset, size_t count, std::string_view str);
+	/*
+	Replaces every occurrence of what, from left to right and without
+	overlapping, with str. Returns the number of replacements.
+	*/
+	size_t replaceAll(std::string_view what, std::string_view str);
+	/*
+	Converts the ASCII letters of the string to upper or lower case.
+	Other bytes are left as is.
+	*/
+	mutablestring& toUpper();
+	mutablestring& toLower();
+
+	char& operator [](size_t);
+	char operator [](size_t) const;
+
+	/*
+	Makes room for at least capacity bytes in total.
+	*/
+	void reserve(size_t capacity);
+	/*
+	Forgets the contents, keeping the buffer for reuse.
+	*/
+	void clear();
+	size_t length() const;
+	/*
+	The pointer and the view are invalidated by any edit.
+	*/
+	const char* c_str() const;
+	std::string_view view() const;
+	operator std::string_view() const;
+
+	/*
+	Interns the contents and returns them as a string, leaving this
+	mutablestring empty. When no resource holds the contents yet, the
+	buffer becomes that resource instead of being copied, as long as
+	it is at least half full and too large for the small blocks of the
+	arena. Otherwise the buffer is kept for reuse.
+	*/
+	string freeze();
+
+	char* begin();
+	char* end();
+	const char* begin() const;
+	const char* end() const;
+};
+
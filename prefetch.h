@@ -0,0 +1,18 @@
+#pragma once
+#if defined(_M_X64) || defined(_M_IX86)
+#include <xmmintrin.h>
+#endif
+
+/*
+Starts loading the cache line holding address into the cache, without
+waiting for it. Does nothing on compilers that offer no way to do so.
+*/
+inline void prefetchRead(const void* address) {
+#if defined(_M_X64) || defined(_M_IX86)
+	_mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#elif defined(__GNUC__) || defined(__clang__)
+	__builtin_prefetch(address);
+#else
+	(void)address;
+#endif
+}
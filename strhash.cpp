@@ -1,11 +1,142 @@
 #include "strhash.h"
-#include <cmath>
+#include <cstdint>
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+/*
+Strings are hashed as polynomials over the integers modulo the Mersenne
+prime P = 2^61 - 1:
+	hash(s) = (s[0] + 1) * B^(n-1) + (s[1] + 1) * B^(n-2) + ... + (s[n-1] + 1)
+Adding one to each byte keeps leading zero bytes significant. The hash
+of a concatenation only depends on the hashes of both parts and on the
+size of the right-hand one, so hashes can be extended and combined
+without reading the bytes again. Two distinct strings of at most n
+bytes collide with a probability of about n / 2^61.
+Bytes are consumed in blocks of up to 32. Within a block, every byte
+is multiplied by the matching power of B split into 32-bit halves, so
+all products fit in 64 bits and the loop vectorizes into packed 32-bit
+multiplies. A single 128-bit multiplication per block then folds the
+block into the running hash. Every platform computes the same value,
+whichever way the 128-bit products are obtained.
+*/
+
+namespace {
+
+	using namespace strhash_detail;
+
+	inline Wide mulWide(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+		unsigned __int128 p = (unsigned __int128)a * b;
+		return Wide{ (uint64_t)p, (uint64_t)(p >> 64) };
+#elif defined(_MSC_VER) && defined(_M_X64)
+		Wide res = {};
+		res.lo = _umul128(a, b, &res.hi);
+		return res;
+#else
+		return mulPortable(a, b);
+#endif
+	}
+
+	inline uint64_t mulMod(uint64_t a, uint64_t b) {
+		return reduce(mulWide(a, b));
+	}
+
+	constexpr size_t BLOCK = 32;
+
+	struct PowerTable {
+		uint64_t full[BLOCK + 1];  // full[i] = B^i
+		uint32_t lo[BLOCK];        // lo[i] = B^(BLOCK-1-i) & 0xFFFFFFFF
+		uint32_t hi[BLOCK];        // hi[i] = B^(BLOCK-1-i) >> 32
+	};
+
+	constexpr PowerTable makePowerTable() {
+		PowerTable table = {};
+		table.full[0] = 1;
+		for (size_t i = 1; i <= BLOCK; i++)
+			table.full[i] = mulModPortable(table.full[i - 1], BASE);
+		for (size_t i = 0; i < BLOCK; i++) {
+			table.lo[i] = (uint32_t)(table.full[BLOCK - 1 - i] & 0xFFFFFFFF);
+			table.hi[i] = (uint32_t)(table.full[BLOCK - 1 - i] >> 32);
+		}
+		return table;
+	}
+
+	constexpr PowerTable POWERS = makePowerTable();
+
+	uint64_t powBase(size_t exponent) {
+		uint64_t res = 1;
+		uint64_t factor = BASE;
+		while (exponent) {
+			if (exponent & 1)
+				res = mulMod(res, factor);
+			factor = mulMod(factor, factor);
+			exponent >>= 1;
+		}
+		return res;
+	}
+
+	// a block is worth hi * 2^32 + lo, which stays below 2^76.
+	inline uint64_t foldBlock(uint64_t lo, uint64_t hi) {
+		return (lo & MODULUS) + (lo >> 61) + ((hi << 32) & MODULUS) + (hi >> 29);
+	}
+
+	inline uint32_t digit(const char* str, size_t i) {
+		return (uint32_t)(unsigned char)str[i] + 1;
+	}
+}
 
 
 hash_t computeHash(const char* str, size_t sz) {
+	return extendHash(0, str, sz);
+}
+
+hash_t extendHash(hash_t hash, const char* str, size_t sz) {
+	uint64_t res = (uint64_t)hash;
+	size_t i = 0;
+	for (; i + BLOCK <= sz; i += BLOCK) {
+		uint64_t lo = 0, hi = 0;
+		for (size_t j = 0; j < BLOCK; j++) {
+			uint32_t d = digit(str, i + j);
+			lo += (uint64_t)d * POWERS.lo[j];
+			hi += (uint64_t)d * POWERS.hi[j];
+		}
+		res = reduce(add(mulWide(res, POWERS.full[BLOCK]), Wide{ foldBlock(lo, hi), 0 }));
+	}
+	if (i < sz) {
+		size_t count = sz - i;
+		// byte j of the last block is weighted by B^(count-1-j).
+		const uint32_t* lo_powers = POWERS.lo + (BLOCK - count);
+		const uint32_t* hi_powers = POWERS.hi + (BLOCK - count);
+		uint64_t lo = 0, hi = 0;
+		for (size_t j = 0; j < count; j++) {
+			uint32_t d = digit(str, i + j);
+			lo += (uint64_t)d * lo_powers[j];
+			hi += (uint64_t)d * hi_powers[j];
+		}
+		res = reduce(add(mulWide(res, POWERS.full[count]), Wide{ foldBlock(lo, hi), 0 }));
+	}
+	return (hash_t)res;
+}
+
+hash_t combineHash(hash_t left, hash_t right, size_t right_size) {
+	uint64_t shifted = mulMod((uint64_t)left, powBase(right_size));
+	return (hash_t)reduce(Wide{ shifted + (uint64_t)right, 0 });
+}
+
+hash_t repeatHash(hash_t hash, size_t sz, size_t times) {
+	// binary exponentiation: unit holds the hash of a power of two copies.
 	hash_t res = 0;
-	for (int i = 0; i < sz; i++) {
-		res += (hash_t)(str[i] * pow(31, i));
+	hash_t unit = hash;
+	size_t unit_size = sz;
+	while (times) {
+		if (times & 1)
+			res = combineHash(res, unit, unit_size);
+		times >>= 1;
+		if (times) {
+			unit = combineHash(unit, unit, unit_size);
+			unit_size *= 2;
+		}
 	}
 	return res;
 }
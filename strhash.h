@@ -1,5 +1,78 @@
 #pragma once
 #include "resource.hpp"
+#include <cstddef>
+#include <cstdint>
+
+/*
+Arithmetic modulo 2^61 - 1 shared by computeHash and constantHash.
+Everything here is portable and usable in constant expressions.
+*/
+namespace strhash_detail {
+
+	constexpr uint64_t MODULUS = (1ull << 61) - 1;
+	constexpr uint64_t BASE = 0x0B3A1F6D2C95E487ull;  // any value below MODULUS will do
+
+	struct Wide {
+		uint64_t lo;
+		uint64_t hi;
+	};
+
+	constexpr Wide mulPortable(uint64_t a, uint64_t b) {
+		uint64_t a0 = a & 0xFFFFFFFF, a1 = a >> 32;
+		uint64_t b0 = b & 0xFFFFFFFF, b1 = b >> 32;
+		uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+		uint64_t mid = (p00 >> 32) + (p01 & 0xFFFFFFFF) + (p10 & 0xFFFFFFFF);
+		return Wide{ (mid << 32) | (p00 & 0xFFFFFFFF), p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32) };
+	}
+
+	constexpr Wide add(Wide a, Wide b) {
+		uint64_t lo = a.lo + b.lo;
+		return Wide{ lo, a.hi + b.hi + (lo < a.lo) };
+	}
+
+	// valid for any x below 2^125, which covers every sum computed here.
+	constexpr uint64_t reduce(Wide x) {
+		uint64_t r = (x.lo & MODULUS) + (x.lo >> 61) + ((x.hi << 3) & MODULUS) + (x.hi >> 58);
+		r = (r & MODULUS) + (r >> 61);
+		return r >= MODULUS ? r - MODULUS : r;
+	}
+
+	constexpr uint64_t mulModPortable(uint64_t a, uint64_t b) {
+		return reduce(mulPortable(a, b));
+	}
+}
 
 
 hash_t computeHash(const char*, size_t);
+
+/*
+Same as computeHash, but usable in constant expressions, so that the
+hash of a string known at compile time costs nothing at runtime. It
+reads one byte at a time, so computeHash is faster at runtime.
+*/
+constexpr hash_t constantHash(const char* str, size_t sz) {
+	uint64_t res = 0;
+	for (size_t i = 0; i < sz; i++)
+		res = strhash_detail::reduce(strhash_detail::add(strhash_detail::mulPortable(res, strhash_detail::BASE),
+			strhash_detail::Wide{ (uint64_t)(unsigned char)str[i] + 1, 0 }));
+	return (hash_t)res;
+}
+
+/*
+Returns the hash of the string whose hash is `hash`, followed by the
+sz bytes of str. Hashing a string in chunks this way gives the same
+result as hashing it in one go.
+*/
+hash_t extendHash(hash_t hash, const char* str, size_t sz);
+
+/*
+Returns the hash of the concatenation of two strings, given their
+hashes and the size of the right-hand one. No byte is read.
+*/
+hash_t combineHash(hash_t left, hash_t right, size_t right_size);
+
+/*
+Returns the hash of a string repeated `times` times, given its hash
+and size. No byte is read.
+*/
+hash_t repeatHash(hash_t hash, size_t sz, size_t times);
@@ -1,250 +1,451 @@
 #include "string.hpp"
 #include "StringResourceList.hpp"
 #include "strhash.h"
+#include "strsearch.h"
+#include "stringbuilder.hpp"
 #include "StringIndexOutOfBoundsException.hpp"
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+static_assert(std::contiguous_iterator<string::ConstIterator>);
+
+/*
+Strings of up to SMALLSTR_capacity bytes never reach the list of string
+resources. Their bytes are stored inline in the string object, zero
+padded, and their length is encoded in the resource index itself, as
+SMALLSTR_resource - length. Like interned strings, two equal short
+strings always end up with the same representation.
+*/
 
+constexpr resource_t NULLSTR_resource = -2;
+constexpr resource_t EMPTYSTR_resource = -3;
+constexpr resource_t SMALLSTR_resource = -16;
+constexpr size_t SMALLSTR_capacity = 7;
 
-bool isSingleChar(resource_t resource) {
-	resource_t maybe_char = resource + 384;
-	return maybe_char < CHAR_MAX && maybe_char > CHAR_MIN;
+
+bool isSmall(resource_t resource) {
+	return resource < SMALLSTR_resource && resource >= SMALLSTR_resource - (resource_t)SMALLSTR_capacity;
 }
 
-char resourceToSingleChar(resource_t resource) {
-	return (char)(resource + 384);
+size_t smallLength(resource_t resource) {
+	return (size_t)(SMALLSTR_resource - resource);
 }
 
-resource_t singleCharToResource(char c) {
-	return (resource_t)c - 384;
+resource_t smallResource(size_t length) {
+	return SMALLSTR_resource - (resource_t)length;
 }
 
-constexpr resource_t NULLSTR_resource = -2;
-constexpr resource_t EMPTYSTR_resource = -3;
+uint64_t bigEndianWord(const char* bytes) {
+	uint64_t word;
+	std::memcpy(&word, bytes, sizeof(word));
+	if constexpr (std::endian::native == std::endian::little) {
+#if defined(_MSC_VER)
+		word = _byteswap_uint64(word);
+#else
+		word = __builtin_bswap64(word);
+#endif
+	}
+	return word;
+}
 
+/*
+Strings bound to a whole resource keep its first 8 bytes inline, like
+short strings keep theirs, so that most comparisons are decided
+without reaching the resource. Every resource bound that way is longer
+than SMALLSTR_capacity, so those 8 bytes always exist.
+Slices have SLICE_flag set in their resource index, and hold their
+range in the inline bytes instead. They are never empty, never short
+enough to be stored inline, never cover their whole parent, and always
+reach its end, so that the terminator of the parent is theirs too.
+*/
 
-string::ConstIterator::ConstIterator() :
-	resource(-1), position(0), current_element(0)
-{}
+constexpr resource_t SLICE_flag = (resource_t)1 << 62;
 
-string::ConstIterator::ConstIterator(resource_t resource) :
-	resource(resource), position(0)
-{
-	if (isSingleChar(this->resource)) {
-		this->try_set_from_single_char();
-		return;
-	}
-	if (this->resource < 0) {
-		this->clear(); // make invalid, we don't want to iterate through empty or null string.
-		return;
-	}
-	// we must have our own reference to the resource in case the last string pointing
-	// there is destroyed before us. This also makes the process thread-safe.
-	this->try_bind();
-	this->try_fetch_char();
+
+bool string::isSlice() const {
+	return this->data >= 0 && (this->data & SLICE_flag);
 }
 
-string::ConstIterator::ConstIterator(const string::ConstIterator& src) :
-	resource(src.resource), position(src.position), current_element(src.current_element)
-{
-	if (isSingleChar(this->resource)) {
-		this->try_set_from_single_char();
-		return;
-	}
-	if (this->resource < 0) {
-		this->clear();
-		return;
-	}
-	this->try_bind();
-	this->try_fetch_char();
+resource_t string::resource() const {
+	return this->data & ~SLICE_flag;
 }
 
-string::ConstIterator::ConstIterator(string::ConstIterator&& src) noexcept :
-	resource(src.resource), position(src.position), current_element(src.current_element)
-{
-	src.clear();
+void string::adopt(resource_t resource, const char* contents) {
+	this->data = resource;
+	std::memcpy(this->small, contents, sizeof(this->small));
 }
 
-string::ConstIterator& string::ConstIterator::operator=(const string::ConstIterator& src) {
-	resource_t previous_resource = this->resource;
-	this->resource = src.resource;
-	this->current_element = src.current_element;
-	this->position = src.position;
-	
-	if (isSingleChar(this->resource)) {
-		this->try_set_from_single_char();
-		goto end;
-	}
-	if (this->resource < 0) {
-		this->clear();
-		goto end;
-	}
-	this->try_bind();
 
-end:
-	this->try_unbind(&previous_resource);
-	return *this;
-}
+string::string() : string(nullptr) 
+{}
 
-string::ConstIterator& string::ConstIterator::operator=(string::ConstIterator&& src) noexcept {
-	resource_t previous_resource = this->resource;
-	this->resource = src.resource;
-	this->current_element = src.current_element;
-	this->position = src.position;
+string::string(std::nullptr_t) : data(NULLSTR_resource), small()
+{}
 
-	if (isSingleChar(this->resource)) {
-		this->try_set_from_single_char();
-		goto end;
+string::string(const char* str, size_t sz) : small() {
+	if (sz && str[sz - 1] == 0)  // a trailing terminator is not part of the string.
+		sz--;
+	if (!sz) {
+		this->data = EMPTYSTR_resource;
+		return;
 	}
-	if (this->resource < 0) {
-		this->clear();
+	if (sz <= SMALLSTR_capacity) {
+		this->data = smallResource(sz);
+		std::memcpy(this->small, str, sz);
+		return;
 	}
-
-end:
-	this->try_unbind(&previous_resource);
-	src.clear();
-	return *this;
-}
-
-const string::ConstIterator::value_type& string::ConstIterator::operator *() const {
-	return this->current_element;
+	// the terminator was stripped above already, so the string is bound as it is now.
+	this->adopt(StringResourceList::get().bind(str, sz, computeHash(str, sz)), str);
 }
 
-const string::ConstIterator::value_type* string::ConstIterator::operator->() {
-	return &this->current_element;
-}
+string::string(const char* str) : string(str, std::strlen(str))
+{}
 
-string::ConstIterator& string::ConstIterator::operator++() {
-	if (this->resource == -2) {
-		this->clear();
-		return *this;
+string::string(char c) :
+	data(smallResource(1)), small()
+{
+	this->small[0] = c;
+}
+
+namespace {
+	// DIGIT_PAIRS[2 * n] and DIGIT_PAIRS[2 * n + 1] are the two digits of n, for n below 100.
+	constexpr char DIGIT_PAIRS[] =
+		"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+		"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+		"8081828384858687888990919293949596979899";
+
+	// writes the digits of value, two at a time, so that they end right before end.
+	char* writeDigits(char* end, uint64_t value) {
+		while (value >= 100) {
+			const char* pair = DIGIT_PAIRS + 2 * (value % 100);
+			value /= 100;
+			*--end = pair[1];
+			*--end = pair[0];
+		}
+		if (value >= 10) {
+			const char* pair = DIGIT_PAIRS + 2 * value;
+			*--end = pair[1];
+			*--end = pair[0];
+		} else {
+			*--end = (char)('0' + value);
+		}
+		return end;
+	}
+}
+
+string string::fromSigned(long long value) {
+	char digits[20];  // "-9223372036854775808"
+	char* end = digits + sizeof(digits);
+	char* start = writeDigits(end, value < 0 ? 0 - (uint64_t)value : (uint64_t)value);
+	if (value < 0)
+		*--start = '-';
+	return fromBuffer(&start, 0, (size_t)(end - start));
+}
+
+string string::fromUnsigned(unsigned long long value) {
+	char digits[20];  // "18446744073709551615"
+	char* end = digits + sizeof(digits);
+	char* start = writeDigits(end, (uint64_t)value);
+	return fromBuffer(&start, 0, (size_t)(end - start));
+}
+
+string string::fromFloating(double value) {
+	char digits[64];
+	char* start = digits;
+	std::to_chars_result res = std::to_chars(digits, digits + sizeof(digits), value);
+	return fromBuffer(&start, 0, res.ec == std::errc() ? (size_t)(res.ptr - digits) : 0);
+}
+
+string string::fromFloating(long double value) {
+	// most values come from doubles, which format much faster, and to what they were written as.
+	double narrow = (double)value;
+	if ((long double)narrow == value)
+		return fromFloating(narrow);
+	char digits[128];
+	char* start = digits;
+	std::to_chars_result res = std::to_chars(digits, digits + sizeof(digits), value);
+	return fromBuffer(&start, 0, res.ec == std::errc() ? (size_t)(res.ptr - digits) : 0);
+}
+
+string::string(bool value) : data(NULLSTR_resource), small() {
+	char* start = const_cast<char*>(value ? "true" : "false");
+	*this = fromBuffer(&start, 0, value ? 4 : 5);
+}
+
+string string::fromBuffer(char** buffer, size_t capacity, size_t sz) {
+	string res;
+	if (!sz) {
+		res.data = EMPTYSTR_resource;
+		return res;
 	}
-	if (this->resource < 0)
-		return *this;
-	this->position++;
-	this->try_fetch_char();
-	return *this;
-}
-
-string::ConstIterator string::ConstIterator::operator++(int) {
-	ConstIterator res = *this;
-	++(*this);
+	if (sz <= SMALLSTR_capacity) {
+		res.data = smallResource(sz);
+		std::memcpy(res.small, *buffer, sz);
+		return res;
+	}
+	hash_t hash = computeHash(*buffer, sz);
+	if (!capacity) {
+		res.adopt(StringResourceList::get().bind(*buffer, sz, hash), *buffer);
+		return res;
+	}
+	// the first bytes are read before the buffer may be handed over to the resource.
+	char contents[sizeof(res.small)];
+	std::memcpy(contents, *buffer, sizeof(contents));
+	res.adopt(StringResourceList::get().bindBuffer(buffer, capacity, sz, hash), contents);
 	return res;
 }
 
-bool string::ConstIterator::operator==(const string::ConstIterator& other) const {
-	if (this->resource == -1) {
-		return other.resource == -1;
+std::vector<string> string::internMany(std::span<const std::string_view> pieces) {
+	std::vector<string> res(pieces.size());
+	std::vector<std::pair<const char*, size_t>> distinct;
+	std::vector<hash_t> hashes;
+	// position in distinct of each piece going through the table, or -1.
+	std::vector<uint32_t> owner(pieces.size(), UINT32_MAX);
+
+	// open addressing table of the distinct pieces, used to spot repeated ones.
+	struct Seen {
+		hash_t hash;
+		uint32_t position;  // in distinct, plus one, or 0 if the bucket is free
+	};
+	size_t table_size = 16;
+	while (table_size < pieces.size() * 2)
+		table_size <<= 1;
+	std::vector<Seen> seen(table_size);
+
+	for (size_t i = 0; i < pieces.size(); i++) {
+		const char* str = pieces[i].data();
+		size_t sz = pieces[i].size();
+		if (sz && str[sz - 1] == 0)
+			sz--;
+		if (sz <= SMALLSTR_capacity) {
+			res[i].data = sz ? smallResource(sz) : EMPTYSTR_resource;
+			std::memcpy(res[i].small, str, sz);
+			continue;
+		}
+		hash_t hash = computeHash(str, sz);
+		size_t bucket = (size_t)hash & (table_size - 1);
+		for (;; bucket = (bucket + 1) & (table_size - 1)) {
+			Seen& entry = seen[bucket];
+			if (!entry.position) {
+				entry.hash = hash;
+				entry.position = (uint32_t)distinct.size() + 1;
+				owner[i] = (uint32_t)distinct.size();
+				distinct.emplace_back(str, sz);
+				hashes.push_back(hash);
+				break;
+			}
+			if (entry.hash == hash) {
+				const std::pair<const char*, size_t>& candidate = distinct[entry.position - 1];
+				if (candidate.second == sz && !std::memcmp(candidate.first, str, sz)) {
+					owner[i] = entry.position - 1;
+					break;
+				}
+			}
+		}
+	}
+
+	std::vector<resource_t> resources(distinct.size());
+	StringResourceList& list = StringResourceList::get();
+	list.bindMany(distinct, hashes.data(), resources.data());
+
+	// the batch holds one binding per distinct piece, the repeated ones are bound all at once.
+	std::vector<size_t> repeats(distinct.size());
+	for (size_t i = 0; i < pieces.size(); i++) {
+		if (owner[i] == UINT32_MAX)
+			continue;
+		res[i].adopt(resources[owner[i]], distinct[owner[i]].first);
+		repeats[owner[i]]++;
 	}
-	return this->resource == other.resource &&
-		this->position == other.position;
+	for (size_t d = 0; d < distinct.size(); d++) {
+		if (repeats[d] > 1)
+			list.bind(resources[d], repeats[d] - 1);
+	}
+	return res;
 }
 
-bool string::ConstIterator::operator!=(const string::ConstIterator& other) const {
-	return !(*this == other);
-}
+namespace {
 
-size_t string::ConstIterator::resource_length() const {
-	if (this->resource < 0)
-		return isSingleChar(this->resource);
-	return StringResourceList::get().size(this->resource);
-}
+	struct SortItem {
+		uint64_t key;  // 8 bytes of the string from the current depth, zero padded
+		size_t index;
+		size_t length;  // only known below the first depth
+	};
+
+	// ranges smaller than this are sorted by comparison.
+	constexpr size_t RADIX_THRESHOLD = 256;
+	// groups sharing this many first bytes are sorted by comparison.
+	constexpr size_t MAX_RADIX_DEPTH = 64;
 
-void string::ConstIterator::try_bind() {
-	if (StringResourceList::get().bind(this->resource) < 0) {
-		this->clear();
+	uint64_t keyAt(std::string_view contents, size_t depth) {
+		char bytes[8] = {};
+		if (depth < contents.size())
+			std::memcpy(bytes, contents.data() + depth, std::min(sizeof(bytes), contents.size() - depth));
+		return bigEndianWord(bytes);
 	}
-}
 
-void string::ConstIterator::try_fetch_char() {
 	/*
-	this->current_element is a buffer for passing a character to the user which is iterating over
-	our resource. No matter how he changes its value, the resource will be unaffected. This makes
-	sense because strings are immutable.
+	Sorts items by key, with an LSD radix sort over the bytes of the
+	keys for large ranges. Passes over a byte that all keys share are
+	skipped.
 	*/
-	if (!StringResourceList::get().get(this->resource, this->position, &this->current_element)) {
-		this->clear();
+	void sortByKey(SortItem* items, size_t n, std::vector<SortItem>& buffer) {
+		if (n < RADIX_THRESHOLD) {
+			std::sort(items, items + n, [](const SortItem& a, const SortItem& b) { return a.key < b.key; });
+			return;
+		}
+		std::vector<size_t> counts(8 * 256);
+		for (size_t i = 0; i < n; i++) {
+			for (size_t b = 0; b < 8; b++)
+				counts[b * 256 + ((items[i].key >> (8 * b)) & 0xFF)]++;
+		}
+		if (buffer.size() < n)
+			buffer.resize(n);
+		SortItem* from = items;
+		SortItem* to = buffer.data();
+		for (size_t b = 0; b < 8; b++) {
+			size_t* count = counts.data() + b * 256;
+			if (count[(from[0].key >> (8 * b)) & 0xFF] == n)
+				continue;
+			size_t offset = 0;
+			for (size_t d = 0; d < 256; d++) {
+				size_t c = count[d];
+				count[d] = offset;
+				offset += c;
+			}
+			for (size_t i = 0; i < n; i++)
+				to[count[(from[i].key >> (8 * b)) & 0xFF]++] = from[i];
+			std::swap(from, to);
+		}
+		if (from != items)
+			std::memcpy(items, from, n * sizeof(SortItem));
 	}
-}
 
-bool string::ConstIterator::try_unbind(resource_t* presource) {
-	if (*presource >= 0) {
-		StringResourceList::get().unbind(presource);
-		return 1;
-	}
-	return 0;
-}
-
-void string::ConstIterator::try_unbind() {
-	if (this->try_unbind(&this->resource)) {
-		this->clear();
-	}
+	/*
+	Sorts a group of items whose strings share their bytes up to
+	depth + 8, zero padding included.
+	*/
+	void sortGroup(std::span<string> strs, SortItem* items, size_t n, size_t depth, std::vector<SortItem>& buffer) {
+		if (n < 2)
+			return;
+		auto less = [&](const SortItem& a, const SortItem& b) { return strs[a.index] < strs[b.index]; };
+		if (depth >= MAX_RADIX_DEPTH) {
+			std::sort(items, items + n, less);
+			return;
+		}
+		size_t next_depth = depth + 8;
+		for (size_t i = 0; i < n; i++) {
+			std::string_view contents = strs[items[i].index].view();
+			items[i].key = keyAt(contents, next_depth);
+			items[i].length = contents.size();
+		}
+		// strings ending within the shared bytes come first, and only differ by their length or nullness.
+		SortItem* rest = std::partition(items, items + n, [&](const SortItem& item) {
+			return item.length <= next_depth;
+		});
+		std::sort(items, rest, less);
+
+		size_t count = items + n - rest;
+		sortByKey(rest, count, buffer);
+		for (size_t start = 0; start < count;) {
+			size_t end = start + 1;
+			while (end < count && rest[end].key == rest[start].key)
+				end++;
+			sortGroup(strs, rest + start, end - start, next_depth, buffer);
+			start = end;
+		}
+	}
+}
+
+void string::sort(std::span<string> strs) {
+	std::vector<SortItem> items(strs.size());
+	for (size_t i = 0; i < strs.size(); i++) {
+		const string& str = strs[i];
+		items[i].key = str.isSlice() ? keyAt(str.view(), 0) : bigEndianWord(str.small);
+		items[i].index = i;
+		items[i].length = 0;
+	}
+	std::vector<SortItem> buffer;
+	sortByKey(items.data(), items.size(), buffer);
+	for (size_t start = 0; start < items.size();) {
+		size_t end = start + 1;
+		while (end < items.size() && items[end].key == items[start].key)
+			end++;
+		sortGroup(strs, items.data() + start, end - start, 0, buffer);
+		start = end;
+	}
+
+	std::vector<string> sorted;
+	sorted.reserve(strs.size());
+	for (const SortItem& item : items)
+		sorted.push_back(std::move(strs[item.index]));
+	std::move(sorted.begin(), sorted.end(), strs.begin());
+}
+
+void string::releaseMany(std::span<string> strs) {
+	std::vector<resource_t> resources;
+	resources.reserve(strs.size());
+	for (string& str : strs) {
+		if (str.data >= 0)
+			resources.push_back(str.resource());
+		str.data = NULLSTR_resource;
+		std::memset(str.small, 0, sizeof(str.small));
+	}
+	StringResourceList::get().unbindMany(resources);
+}
+
+string string::fromStatic(void* block, size_t sz, hash_t hash) {
+	char* contents = StringResource::contentsOf(block);
+	if (sz <= SMALLSTR_capacity)
+		return fromBuffer(&contents, 0, sz);
+	string res;
+	res.adopt(StringResourceList::get().bindStatic(StringResource::adopt(block, sz, hash)), contents);
+	return res;
 }
 
-void string::ConstIterator::try_set_from_single_char() {
-	this->current_element = resourceToSingleChar(this->resource);
-	this->resource = -2;
-	this->position = 0;
+void string::deferReleases(bool enabled) {
+	StringResourceList::deferReleases(enabled);
 }
 
-void string::ConstIterator::clear() {
-	this->resource = -1;
-	this->current_element = 0;
-	this->position = 0;
+void string::flushReleases() {
+	StringResourceList::get().flushReleases();
 }
 
-string::ConstIterator::~ConstIterator() {
-	this->try_unbind();
+void string::pin() const {
+	if (this->data >= 0)
+		StringResourceList::get().pin(this->resource());
 }
 
-
-string::string() : string(nullptr) 
-{}
-
-string::string(std::nullptr_t) : data(NULLSTR_resource)
-{}
-
-string::string(const char* str, size_t sz) {
-	if (!sz) {
-		this->data = EMPTYSTR_resource;
-		return;
-	}
-	if (sz == 1) {
-		this->data = singleCharToResource(str[0]);
-		return;
-	}
-	this->data = StringResourceList::get().bind(str, sz);
-}
-
-string::string(const char* str) : string(str, std::strlen(str))
-{}
-
-string::string(char c) :
-	data(singleCharToResource(c))
-{}
-
-string::string(const string& src) {
-	resource_t old_resource = this->data;
-	this->data = src.data;
+string::string(const string& src) noexcept :
+	data(src.data)
+{
+	std::memcpy(this->small, src.small, sizeof(this->small));
 	if (this->data >= 0) {
-		StringResourceList::get().bind(this->data);
-	}
-	if (old_resource >= 0) {
-		StringResourceList::get().unbind(&old_resource);
+		StringResourceList::get().bind(this->resource());
 	}
 }
 
-string::string(string&& src) noexcept {
-	if (this->data >= 0) {
-		StringResourceList::get().unbind(&this->data);
-	}
-	this->data = src.data;
+string::string(string&& src) noexcept :
+	data(src.data)
+{
+	std::memcpy(this->small, src.small, sizeof(this->small));
 	src.data = -1;
+	std::memset(src.small, 0, sizeof(src.small));
 }
 
 string& string::operator=(const string& src) {
-	resource_t old_resource = this->data;
+	resource_t old_resource = this->data >= 0 ? this->resource() : -1;
 	this->data = src.data;
+	std::memcpy(this->small, src.small, sizeof(this->small));
 	if (this->data >= 0) {
-		StringResourceList::get().bind(this->data);
+		StringResourceList::get().bind(this->resource());
 	}
 	if (old_resource >= 0) {
 		StringResourceList::get().unbind(&old_resource);
@@ -254,168 +455,505 @@ string& string::operator=(const string& src) {
 
 string& string::operator=(string&& src) noexcept {
 	if (this->data >= 0) {
-		StringResourceList::get().unbind(&this->data);
+		resource_t old_resource = this->resource();
+		StringResourceList::get().unbind(&old_resource);
 	}
 	this->data = src.data;
+	std::memcpy(this->small, src.small, sizeof(this->small));
 	src.data = -1;
+	std::memset(src.small, 0, sizeof(src.small));
 	return *this;
 }
 
-string string::operator +(const string other) const {
+const char* string::c_str() const {
+	// short strings are zero padded, interned ones are stored with a terminator.
+	if (isSmall(this->data))
+		return this->small;
+	if (this->data == EMPTYSTR_resource)
+		return "";
+	if (this->data < 0)
+		return nullptr;
+	// slices end where their parent does, so they share its terminator.
+	if (this->isSlice())
+		return this->view().data();
+	return StringResourceList::get().buffer(this->data);
+}
+
+std::string_view string::view() const {
+	if (isSmall(this->data))
+		return std::string_view(this->small, smallLength(this->data));
+	if (this->data < 0)
+		return std::string_view("", 0);
+	std::span<const char> contents = StringResourceList::get().span(this->resource());
+	if (this->isSlice())
+		return std::string_view(contents.data() + this->slice.offset, this->slice.count);
+	return std::string_view(contents.data(), contents.size());
+}
+
+string string::operator +(const string& other) const& {
 	if (!this->length())
 		return other;
 	if (!other.length())
 		return *this;
   
-	hash_t hash_sum = this->hash() + other.hash();
-	resource_t result_data = StringResourceList::get().find(hash_sum);
-	if (result_data >= 0) {
-		string result;
-		result.data = result_data;
-		return result;
-	}
-
 	size_t res_size = this->length() + other.length();
-	
-	char s_uchr;
-	const char* self_buffer = StringResourceList::get().buffer(this->data);
-	if (!self_buffer) {
-		if (isSingleChar(this->data)) {
-			s_uchr = resourceToSingleChar(this->data);
-			self_buffer = &s_uchr;
-		} else
-			return other;
-	}
-
-	char o_uchr;
-	const char* other_buffer = StringResourceList::get().buffer(other.data);
-	if (!other_buffer) {
-		if (isSingleChar(other.data)) {
-			o_uchr = resourceToSingleChar(other.data);
-			other_buffer = &o_uchr;
-		} else
-			return *this;
+	const char* self_buffer = this->view().data();
+	const char* other_buffer = other.view().data();
+
+	if (res_size <= SMALLSTR_capacity) {
+		string res;
+		res.data = smallResource(res_size);
+		std::memcpy(res.small, self_buffer, this->length());
+		std::memcpy(res.small + this->length(), other_buffer, other.length());
+		return res;
 	}
 
 	char* res_str = new char[res_size + 1];
 	std::memcpy(res_str, self_buffer, this->length());
 	std::memcpy(res_str + this->length(), other_buffer, other.length());
 
-	string res = { res_str, res_size };
+	// the hash of the result follows from the hashes of both sides.
+	hash_t res_hash = combineHash(this->hash(), other.hash(), other.length());
+	string res;
+	res.adopt(StringResourceList::get().bind(res_str, res_size, res_hash), res_str);
 	delete[] res_str;
 	return res;
 }
 
-string string::operator+=(const string other) {
-	(*this) = (*this) + other;
+string string::operator +(const string& other) && {
+	if (this->length() && !other.length())
+		return std::move(*this);
+	return std::as_const(*this) + other;
+}
+
+string& string::operator+=(const string& other) {
+	(*this) = std::move(*this) + other;
 	return *this;
 }
 
-string::operator const char* () const {
+string string::operator *(const size_t times) const {
 	if (this->data == NULLSTR_resource)
-		return nullptr;
-	if (this->data == EMPTYSTR_resource)
-		return "";
-	char* res = new char[this->length() + 1];
-	if (isSingleChar(this->data)) {
-		res[0] = resourceToSingleChar(this->data);
-		res[1] = 0;
+		return *this;
+	size_t len = this->length();
+	if (!len || !times)
+		return string("", 0);
+	if (times == 1)
+		return *this;
+	if (len > (SIZE_MAX - 1) / times)
+		throw std::bad_alloc();
+
+	size_t res_size = len * times;
+	std::string_view self = this->view();
+	char* res_str;
+	char inline_buffer[SMALLSTR_capacity];
+	if (res_size <= SMALLSTR_capacity)
+		res_str = inline_buffer;
+	else
+		res_str = new char[res_size + 1];
+
+	// copies the string once, then doubles the filled part until it is done.
+	std::memcpy(res_str, self.data(), len);
+	size_t filled = len;
+	while (filled < res_size) {
+		size_t chunk = std::min(filled, res_size - filled);
+		std::memcpy(res_str + filled, res_str, chunk);
+		filled += chunk;
+	}
+
+	string res;
+	if (res_size <= SMALLSTR_capacity) {
+		res.data = smallResource(res_size);
+		std::memcpy(res.small, res_str, res_size);
 		return res;
 	}
-	if (!StringResourceList::get().copy(this->data, res))
-		return nullptr;
+	// the hash of the result follows from the hash of one copy.
+	hash_t res_hash = repeatHash(this->hash(), len, times);
+	res.adopt(StringResourceList::get().bind(res_str, res_size, res_hash), res_str);
+	delete[] res_str;
 	return res;
 }
 
+string& string::operator*=(const size_t times) {
+	(*this) = std::as_const(*this) * times;
+	return *this;
+}
+
+string::operator const char* () const {
+	return this->c_str();
+}
+
+string::operator std::string_view() const {
+	return this->view();
+}
+
 bool string::operator==(std::nullptr_t) const {
 	return this->data == NULLSTR_resource;
 }
 
-bool string::operator==(const string other) const {
-	return this->hash() == other.hash();
+bool string::operator==(const string& other) const {
+	// apart from slices, every string has exactly one representation, so identity is equality.
+	if (this->data == other.data && !std::memcmp(this->small, other.small, sizeof(this->small)))
+		return 1;
+	if (!this->isSlice() && !other.isSlice())
+		return 0;
+	return this->view() == other.view();
 }
 
-bool string::operator>=(const string other) const {
-	return this->hash() >= other.hash();
+bool string::operator==(std::string_view other) const {
+	return this->data != NULLSTR_resource && this->view() == other;
 }
 
-bool string::operator>(const string other) const {
-	return this->hash() > other.hash();
+bool string::operator==(const char* other) const {
+	if (!other)
+		return this->data == NULLSTR_resource;
+	return *this == std::string_view(other);
 }
 
-bool string::operator<=(const string other) const {
-	return this->hash() <= other.hash();
-}
+std::strong_ordering string::operator<=>(const string& other) const {
+	if (this->data == other.data && !std::memcmp(this->small, other.small, sizeof(this->small)))
+		return std::strong_ordering::equal;
+	if (this->data == NULLSTR_resource)
+		return std::strong_ordering::less;
+	if (other.data == NULLSTR_resource)
+		return std::strong_ordering::greater;
+	if (!this->isSlice() && !other.isSlice()) {
+		// the first 8 bytes, zero padded and read most significant first, order like the strings.
+		uint64_t left = bigEndianWord(this->small), right = bigEndianWord(other.small);
+		if (left != right)
+			return left <=> right;
+	}
 
-bool string::operator<(const string other) const {
-	return this->hash() < other.hash();
+	std::string_view left = this->view(), right = other.view();
+	int res = std::memcmp(left.data(), right.data(), left.size() < right.size() ? left.size() : right.size());
+	if (res)
+		return res < 0 ? std::strong_ordering::less : std::strong_ordering::greater;
+	return left.size() <=> right.size();
 }
 
 char string::operator [](size_t i) const {
-	if (i >= this->length())
+	std::string_view contents = this->view();
+	if (i >= contents.size())
 		throw StringIndexOutOfBoundsException("Index out of bounds.");
-	char res;
-	if (isSingleChar(this->data)) {
-		return resourceToSingleChar(this->data);
-	}
-	if (!StringResourceList::get().get(this->data, i, &res))
-		throw StringIndexOutOfBoundsException("Index out of bounds.");
-	return res;
+	return contents[i];
 }
 
 hash_t string::hash() const {
-	hash_t hash;
-	if (StringResourceList::get().hash(this->data, &hash))
-		return hash;
-	if (isSingleChar(this->data)) {
-		return resourceToSingleChar(this->data);
+	if (isSmall(this->data)) {
+		return computeHash(this->small, smallLength(this->data));
 	}
 	if (this->data == NULLSTR_resource) {
 		return INT32_MAX;
 	}
+	if (this->isSlice()) {
+		std::string_view contents = this->view();
+		return computeHash(contents.data(), contents.size());
+	}
+	hash_t hash;
+	if (this->data >= 0 && StringResourceList::get().hash(this->data, &hash))
+		return hash;
 	return 0;
 }
 
 size_t string::length() const {
-	if (isSingleChar(this->data))
-		return 1;
+	if (isSmall(this->data))
+		return smallLength(this->data);
+	if (this->data < 0)
+		return 0;
+	if (this->isSlice())
+		return this->slice.count;
 	if (size_t res = StringResourceList::get().size(this->data))
 		return res;
 	
 	return 0;
 }
 
+bool string::toInt(long long* out) const {
+	std::string_view contents = this->view();
+	long long value;
+	std::from_chars_result res = std::from_chars(contents.data(), contents.data() + contents.size(), value);
+	if (res.ec != std::errc() || res.ptr != contents.data() + contents.size())
+		return 0;
+	*out = value;
+	return 1;
+}
+
+bool string::toDouble(double* out) const {
+	std::string_view contents = this->view();
+	double value;
+	std::from_chars_result res = std::from_chars(contents.data(), contents.data() + contents.size(), value);
+	if (res.ec != std::errc() || res.ptr != contents.data() + contents.size())
+		return 0;
+	*out = value;
+	return 1;
+}
+
+string string::substring(size_t offset, size_t count) const& {
+	return this->substringOf(offset, count, nullptr);
+}
+
+string string::substring(size_t offset, size_t count) && {
+	return this->substringOf(offset, count, this);
+}
+
+string string::substringOf(size_t offset, size_t count, string* owner) const {
+	size_t len = this->length();
+	if (offset > len || count > len - offset)
+		throw StringIndexOutOfBoundsException("Index out of bounds.");
+	if (count == len)
+		return owner ? std::move(*owner) : *this;
+	const char* start = this->view().data() + offset;
+	size_t parent_offset = offset + (this->isSlice() ? this->slice.offset : 0);
+	// only a range reaching the end can share the terminator of the parent.
+	if (count <= SMALLSTR_capacity || offset + count != len || parent_offset + count > UINT32_MAX) {
+		// built as is, since a trailing zero byte of the range is part of it.
+		char* contents = const_cast<char*>(start);
+		return fromBuffer(&contents, 0, count);
+	}
+
+	string res;
+	if (owner) {
+		res.data = owner->resource() | SLICE_flag;
+		owner->data = -1;
+		std::memset(owner->small, 0, sizeof(owner->small));
+	} else {
+		res.data = StringResourceList::get().bind(this->resource()) | SLICE_flag;
+	}
+	res.slice.offset = (uint32_t)parent_offset;
+	res.slice.count = (uint32_t)count;
+	return res;
+}
+
+std::vector<std::string_view> string::splitViews(std::string_view sep) const {
+	std::vector<std::string_view> res;
+	std::string_view contents = this->view();
+	if (sep.empty()) {
+		res.push_back(contents);
+		return res;
+	}
+	size_t start = 0;
+	for (;;) {
+		size_t found = findSubstring(contents.data() + start, contents.size() - start, sep.data(), sep.size());
+		if (found == SEARCH_NOT_FOUND)
+			break;
+		res.push_back(contents.substr(start, found));
+		start += found + sep.size();
+	}
+	res.push_back(contents.substr(start));
+	return res;
+}
+
+std::vector<string> string::split(std::string_view sep) const {
+	std::vector<string> res;
+	std::string_view contents = this->view();
+	if (sep.empty()) {
+		res.push_back(*this);
+		return res;
+	}
+	size_t start = 0;
+	for (;;) {
+		size_t found = findSubstring(contents.data() + start, contents.size() - start, sep.data(), sep.size());
+		if (found == SEARCH_NOT_FOUND)
+			break;
+		res.push_back(this->substring(start, found));
+		start += found + sep.size();
+	}
+	if (!start) {
+		res.push_back(*this);
+		return res;
+	}
+	res.push_back(this->substring(start, contents.size() - start));
+	return res;
+}
+
+string string::join(const std::vector<string>& parts) const {
+	if (parts.empty())
+		return string("");
+	if (parts.size() == 1)
+		return parts[0];
+
+	size_t res_size = this->length() * (parts.size() - 1);
+	for (const string& part : parts)
+		res_size += part.length();
+
+	stringbuilder res(res_size);
+	for (size_t i = 0; i < parts.size(); i++) {
+		if (i)
+			res.append(*this);
+		res.append(parts[i]);
+	}
+	return res.build();
+}
+
+string string::removePrefix(std::string_view prefix) const& {
+	if (prefix.empty() || !this->startsWith(prefix))
+		return *this;
+	return this->substring(prefix.size(), this->length() - prefix.size());
+}
+
+string string::removePrefix(std::string_view prefix) && {
+	if (prefix.empty() || !this->startsWith(prefix))
+		return std::move(*this);
+	return std::move(*this).substring(prefix.size(), this->length() - prefix.size());
+}
+
+string string::removeSuffix(std::string_view suffix) const& {
+	if (suffix.empty() || !this->endsWith(suffix))
+		return *this;
+	return this->substring(0, this->length() - suffix.size());
+}
+
+string string::removeSuffix(std::string_view suffix) && {
+	if (suffix.empty() || !this->endsWith(suffix))
+		return std::move(*this);
+	return std::move(*this).substring(0, this->length() - suffix.size());
+}
+
+bool string::startsWith(std::string_view prefix) const {
+	if (!this->isSlice()) {
+		// the inline bytes reject most prefixes without reaching the resource.
+		size_t known = isSmall(this->data) ? smallLength(this->data) : this->data >= 0 ? sizeof(this->small) : 0;
+		if (std::memcmp(this->small, prefix.data(), known < prefix.size() ? known : prefix.size()))
+			return 0;
+	}
+	std::string_view contents = this->view();
+	return prefix.size() <= contents.size() && !std::memcmp(contents.data(), prefix.data(), prefix.size());
+}
+
+bool string::endsWith(std::string_view suffix) const {
+	std::string_view contents = this->view();
+	return suffix.size() <= contents.size() &&
+		!std::memcmp(contents.data() + contents.size() - suffix.size(), suffix.data(), suffix.size());
+}
+
+bool string::contains(std::string_view needle) const {
+	std::string_view contents = this->view();
+	return findSubstring(contents.data(), contents.size(), needle.data(), needle.size()) != SEARCH_NOT_FOUND;
+}
+
+string string::fill(char what, size_t max) const {
+	size_t len = this->length();
+	if (len >= max)
+		return *this;
+	string res;
+	if (max <= SMALLSTR_capacity) {
+		res.data = smallResource(max);
+		std::memcpy(res.small, this->view().data(), len);
+		std::memset(res.small + len, what, max - len);
+		return res;
+	}
+	char* res_str = new char[max];
+	std::memcpy(res_str, this->view().data(), len);
+	std::memset(res_str + len, what, max - len);
+	// the string is bound as is, so that a zero byte of padding is kept.
+	res.adopt(StringResourceList::get().bind(res_str, max, computeHash(res_str, max)), res_str);
+	delete[] res_str;
+	return res;
+}
+
+size_t string::Hash::operator()(const string& str) const {
+	return (size_t)str.hash();
+}
+
+size_t string::Hash::operator()(std::string_view str) const {
+	return (size_t)computeHash(str.data(), str.size());
+}
+
+size_t string::Hash::operator()(const char* str) const {
+	return (size_t)computeHash(str, std::strlen(str));
+}
+
+bool string::Equal::operator()(const string& left, const string& right) const {
+	return left == right;
+}
+
+bool string::Equal::operator()(const string& left, std::string_view right) const {
+	return !(left == nullptr) && left.view() == right;
+}
+
+bool string::Equal::operator()(std::string_view left, const string& right) const {
+	return (*this)(right, left);
+}
+
+bool string::Equal::operator()(const string& left, const char* right) const {
+	return (*this)(left, std::string_view(right));
+}
+
+bool string::Equal::operator()(const char* left, const string& right) const {
+	return (*this)(right, std::string_view(left));
+}
+
 string::ConstIterator string::begin() const {
-	return ConstIterator(this->data);
+	return this->view().data();
 }
 
 string::ConstIterator string::end() const {
-	return ConstIterator();
+	std::string_view contents = this->view();
+	return contents.data() + contents.size();
 }
 
 string::~string() {
 	if (this->data >= 0) {
-		StringResourceList::get().unbind(&this->data);
+		resource_t resource = this->resource();
+		StringResourceList::get().unbind(&resource);
 	}
 }
 
-std::ostream& operator <<(std::ostream& fs, const string str) {
-	for (char c : str) {
-		fs << c;
-	}
+std::ostream& operator <<(std::ostream& fs, const string& str) {
+	std::string_view contents = str.view();
+	fs.write(contents.data(), contents.size());
 	return fs;
 }
 
 std::istream& operator >>(std::istream& fs, string& str) {
-	str = "";
+	// reused by every extraction made on this thread, so the line is
+	// only copied once, when it gets interned.
+	static thread_local std::string line;
+	std::getline(fs, line);
+	if (!line.empty() && line.back() == '\r')
+		line.pop_back();
+	str = string(line.data(), line.size());
+	return fs;
+}
+
+std::vector<string> readLines(std::istream& fs) {
+	constexpr size_t CHUNK_SIZE = 64 * 1024;
+	constexpr size_t BATCH_SIZE = 64 * 1024;
+	std::vector<string> res;
+	std::streambuf* buf = fs.rdbuf();
+	if (!buf || !fs.good())
+		return res;
+
+	std::string contents;
 	for (;;) {
-		int in = fs.get();
-		if (in == '\r')
-			continue;
-		if (in == '\n' || in == EOF)
+		size_t old_size = contents.size();
+		contents.resize(old_size + CHUNK_SIZE);
+		std::streamsize got = buf->sgetn(contents.data() + old_size, CHUNK_SIZE);
+		contents.resize(old_size + (size_t)(got > 0 ? got : 0));
+		if (got <= 0)
 			break;
-		str += (char)in;
 	}
-	return fs;
+	fs.setstate(std::ios::eofbit);
+
+	// the lines are located first, then interned BATCH_SIZE at a time, which keeps the
+	// table of repeated lines of each batch small enough to stay in cache.
+	std::vector<std::string_view> lines;
+	const char* pos = contents.data();
+	const char* end = pos + contents.size();
+	while (pos < end) {
+		const char* eol = static_cast<const char*>(std::memchr(pos, '\n', end - pos));
+		const char* next = eol ? eol + 1 : end;
+		if (!eol)
+			eol = end;
+		if (eol > pos && eol[-1] == '\r')
+			eol--;
+		lines.emplace_back(pos, eol - pos);
+		pos = next;
+	}
+	res.reserve(lines.size());
+	for (size_t start = 0; start < lines.size(); start += BATCH_SIZE) {
+		std::span<const std::string_view> batch(lines.data() + start, std::min(BATCH_SIZE, lines.size() - start));
+		std::vector<string> interned = string::internMany(batch);
+		res.insert(res.end(), std::make_move_iterator(interned.begin()), std::make_move_iterator(interned.end()));
+	}
+	return res;
 }
-
@@ -1,97 +1,295 @@
 #pragma once
 #include "resource.hpp"
+#include <compare>
+#include <concepts>
+#include <cstdint>
 #include <vector>
 #include <iostream>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
 
 
+/*
+A string is either null, empty, short enough to be stored inline,
+a whole string resource, or a slice of one. A slice covers the end of
+the bytes of its parent resource, so it shares its terminator, and
+holds one binding on it. Ranges that stop before the end of their
+parent are interned instead, so every string gives a terminated buffer
+through c_str() without being modified. Pieces that don't need one are
+taken as std::string_view, through view() or splitViews().
+*/
 class string
 {
 	resource_t data;
+	union {
+		// contents of strings up to 7 bytes long, zero padded, or the first
+		// 8 bytes of the resource a string is bound to as a whole.
+		char small[8];
+		// range of the parent resource covered by a slice.
+		struct {
+			uint32_t offset;
+			uint32_t count;
+		} slice;
+	};
 
-	struct ConstIterator {
-		using iterator_category = std::forward_iterator_tag;
-		using difference_type = std::ptrdiff_t;
-		using value_type = char;
-		using pointer = value_type*;
-		using reference = value_type&;
-
-		ConstIterator(resource_t resource);
-		ConstIterator();
-		ConstIterator(const ConstIterator&);
-		ConstIterator(ConstIterator&&) noexcept;
-
-		ConstIterator& operator =(const ConstIterator&);
-		ConstIterator& operator =(ConstIterator&&) noexcept;
-
-		const value_type& operator *() const;
-		const value_type* operator ->();
-
-		ConstIterator& operator++();
-		ConstIterator operator++(int);
+	bool isSlice() const;
+	resource_t resource() const;
+	void adopt(resource_t resource, const char* contents);
+	// substring, handing the binding of owner over to the result if
+	// owner is not nullptr. owner is this string, as a temporary.
+	string substringOf(size_t offset, size_t count, string* owner) const;
 
-		bool operator ==(const ConstIterator& other) const;
-		bool operator !=(const ConstIterator& other) const;
+	/*
+	Interns the sz bytes of *buffer as they are, trailing zero
+	included. If capacity is not 0, *buffer comes from
+	StringResourceList::allocateBuffer with that capacity, and is set
+	to nullptr if it became the resource of the string.
+	*/
+	static string fromBuffer(char** buffer, size_t capacity, size_t sz);
+	// formatters behind the numeric constructors.
+	static string fromSigned(long long value);
+	static string fromUnsigned(unsigned long long value);
+	static string fromFloating(double value);
+	static string fromFloating(long double value);
 
-		~ConstIterator();
+	friend class mutablestring;
+	friend class stringbuilder;
 
-	private:
-		size_t resource_length() const;
-		void try_bind();
-		bool try_unbind(resource_t*);
-		void try_unbind();
-		void try_fetch_char();
-		void try_set_from_single_char();
-		void clear();
+public:
+	/*
+	Iterators point straight into the contents of the string, so they
+	are contiguous and stay valid as long as view() does.
+	*/
+	using ConstIterator = const char*;
 
-		resource_t resource;
-		size_t position;
-		value_type current_element;
+	/*
+	Hash and equality of strings by their contents, consistent with
+	operator ==. Both also take std::string_view and const char*, so
+	that containers using them can be searched without interning the
+	searched string. The null string is not equal to any of those.
+	*/
+	struct Hash {
+		using is_transparent = void;
+		size_t operator ()(const string&) const;
+		size_t operator ()(std::string_view) const;
+		size_t operator ()(const char*) const;
 	};
-	
-public:
+	struct Equal {
+		using is_transparent = void;
+		bool operator ()(const string&, const string&) const;
+		bool operator ()(const string&, std::string_view) const;
+		bool operator ()(std::string_view, const string&) const;
+		bool operator ()(const string&, const char*) const;
+		bool operator ()(const char*, const string&) const;
+	};
+
 	string();
 	string(std::nullptr_t);
 	string(const char*, size_t);
 	string(const char*);
 	string(char);
 
-	string(const string&);
+	/*
+	Copying a string only binds the resource it already holds, so it
+	never throws, and containers move pairs holding a const string
+	instead of copying them.
+	*/
+	string(const string&) noexcept;
 	string(string&&) noexcept;
 
-	explicit string(long long);
-	explicit string(long double);
+	/*
+	Returns a string for each of the pieces, in order, equal to the
+	one constructing it alone would give. Repeated pieces are looked
+	up once, and the distinct ones are interned in a single batch
+	that locks each shard of the table at most once.
+	*/
+	static std::vector<string> internMany(std::span<const std::string_view> pieces);
+	/*
+	Turns every string of strs into the null string, releasing
+	their resources in a single batch.
+	*/
+	static void releaseMany(std::span<string> strs);
+	/*
+	Makes the calling thread defer releasing the resources of the
+	strings it destroys, or stop doing so, as described by
+	StringResourceList::deferReleases. Copying and destroying the same
+	strings over and over then leaves their shared reference counts
+	alone.
+	*/
+	static void deferReleases(bool enabled);
+	/*
+	Applies the releases deferred by the calling thread.
+	*/
+	static void flushReleases();
+	/*
+	Makes the resource of this string immortal: it is never released,
+	and binding it no longer writes to its reference count, so copies
+	made from many threads at once don't contend. Meant for strings
+	used everywhere for the lifetime of the program. Strings stored
+	inline have no resource, and are left as they are.
+	*/
+	void pin() const;
+	/*
+	Sorts strs in the order of operator <=>, with an MSD radix sort
+	working on 8 bytes at a time. The first 8 bytes of most strings
+	are stored inline, so strings that differ early are sorted without
+	reaching their resources.
+	*/
+	static void sort(std::span<string> strs);
+	/*
+	Returns the string of the sz bytes stored at
+	StringResource::contentsOf(block), whose hash is already known,
+	interning it through StringResourceList::bindStatic if it is too
+	long to be stored inline. block must be suitably aligned, must
+	have room for a resource header followed by the bytes and a
+	terminator, and must live for the rest of the program. This is
+	what the _s literal uses, see strliteral.hpp.
+	*/
+	static string fromStatic(void* block, size_t sz, hash_t hash);
+
+	/*
+	Formats a number as its shortest decimal representation, the one
+	std::to_chars gives, and a bool as "true" or "false", without any
+	allocation. A long double that holds a double exactly is written
+	as that double, so that 0.1 gives "0.1". Results of up to 7
+	characters, which covers every integer from -999999 to 9999999,
+	are stored inline and never reach the list of string resources.
+	Numbers of every type go through templates, which match them
+	exactly, so that none of them is ambiguous. A char still gives the
+	string of that character, and a bool its own overload.
+	*/
+	template <std::integral N>
+		requires (sizeof(N) <= sizeof(long long))
+	explicit string(N value) :
+		string(std::is_signed_v<N> ? fromSigned((long long)value) : fromUnsigned((unsigned long long)value))
+	{}
+	template <std::floating_point F>
+	explicit string(F value) : string(fromFloating(value))
+	{}
 	explicit string(bool);
 
 	string& operator =(const string&);
 	string& operator =(string&&) noexcept;
 
+	/*
+	Returns the contents of the string, terminated by a zero byte,
+	without copying them. The pointer stays valid until this string
+	is assigned to, moved from or destroyed.
+	Returns nullptr for the null string.
+	*/
+	const char* c_str() const;
+	/*
+	The contents of the string, unterminated. The null string gives
+	an empty view.
+	*/
+	std::string_view view() const;
+
 	operator const char* () const;
+	operator std::string_view() const;
 	operator bool() const;
 
-	string operator +(const string) const;
+	/*
+	Each concatenation interns its whole result. Use a stringbuilder
+	to assemble a string out of many pieces.
+	Member functions that may give this string back as their result
+	have an overload for temporaries, which hands its binding over to
+	the result instead of binding again.
+	*/
+	string operator +(const string&) const&;
+	string operator +(const string&) &&;
+	/*
+	Returns the string repeated the specified number of times. The
+	result is built in a single buffer and interned once.
+	Counts of any other integer type go through a template, as they
+	would otherwise be ambiguous with the conversions of string. It
+	throws std::invalid_argument for a negative count.
+	*/
 	string operator *(const size_t) const;
-	string operator +=(const string);
-	string operator *=(const size_t);
+	template <std::integral N>
+	string operator *(N times) const {
+		if constexpr (std::is_signed_v<N>) {
+			if (times < 0)
+				throw std::invalid_argument("Negative repetition count.");
+		}
+		return *this * (size_t)times;
+	}
+	string& operator +=(const string&);
+	string& operator *=(const size_t);
+	template <std::integral N>
+	string& operator *=(N times) {
+		return *this = *this * times;
+	}
 
 	bool operator ==(std::nullptr_t) const;
-	bool operator ==(const string) const;
+	bool operator ==(const string&) const;
+	/*
+	Compares the contents of the string with other, without interning
+	it. The null string is not equal to any view, and only equal to
+	a null pointer.
+	*/
+	bool operator ==(std::string_view other) const;
+	bool operator ==(const char* other) const;
 
-	bool operator >=(const string) const;
-	bool operator >(const string) const;
-	bool operator <=(const string) const;
-	bool operator <(const string) const;
+	/*
+	Orders strings lexicographically by their bytes, taken as unsigned.
+	The null string comes before every other string, the empty one
+	included.
+	*/
+	std::strong_ordering operator <=>(const string&) const;
 
 	char operator [](size_t) const;
 
 	size_t length() const;
-	std::vector<string> split(const string) const;
-	string join(std::vector<string>) const;
-	string removePrefix(const string prefix) const;
-	string removeSuffix(const string suffix) const;
-	bool startsWith(const string) const;
-	bool endsWith(const string) const;
+	/*
+	Parses the whole string as a decimal integer or a floating point
+	number, the way std::from_chars does, and stores it in *out.
+	Returns 0, leaving *out unchanged, if the string is not exactly
+	one number or if the number is out of range.
+	*/
+	bool toInt(long long* out) const;
+	bool toDouble(double* out) const;
+	/*
+	Returns the count bytes of this string starting at offset. When
+	they reach the end of the string, the result shares its resource
+	instead of copying them, and keeps the whole resource alive as
+	long as it lives. Other ranges are interned on their own.
+	Throws StringIndexOutOfBoundsException if the range exceeds the
+	string.
+	*/
+	string substring(size_t offset, size_t count) const&;
+	string substring(size_t offset, size_t count) &&;
+	/*
+	Returns the pieces of this string between occurrences of the
+	separator, empty ones included. An empty separator gives the
+	whole string back as the only piece.
+	The last piece is a slice of this string, and the others are
+	interned on their own.
+	*/
+	std::vector<string> split(std::string_view separator) const;
+	/*
+	Same as split, giving the pieces as views over the contents of
+	this string, which are neither copied nor interned. The views
+	are unterminated, and only valid as long as this string is.
+	*/
+	std::vector<std::string_view> splitViews(std::string_view separator) const;
+	/*
+	Returns the strings of the vector, separated by this string.
+	*/
+	string join(const std::vector<string>& parts) const;
+	string removePrefix(std::string_view prefix) const&;
+	string removePrefix(std::string_view prefix) &&;
+	string removeSuffix(std::string_view suffix) const&;
+	string removeSuffix(std::string_view suffix) &&;
+	bool startsWith(std::string_view prefix) const;
+	bool endsWith(std::string_view suffix) const;
 	hash_t hash() const;
-	bool contains(const string) const;
+	bool contains(std::string_view other) const;
+	/*
+	Returns this string padded on the right with `what`, up to max
+	bytes. Strings already at least max bytes long are returned as is.
+	*/
 	string fill(char what, size_t max) const;
 	
 	ConstIterator begin() const;
@@ -101,6 +299,21 @@ public:
 };
 
 
-std::ostream& operator <<(std::ostream&, const string);
+template <>
+struct std::hash<::string> : ::string::Hash {};
+
+
+std::ostream& operator <<(std::ostream&, const string&);
+/*
+Reads one line into the string, without its line break.
+*/
 std::istream& operator >>(std::istream&, string&);
 
+/*
+Reads everything that is left in the stream and returns it line by
+line, without the line breaks. A last line that is not terminated is
+kept as well. The lines are interned in large batches, through
+string::internMany.
+*/
+std::vector<string> readLines(std::istream&);
+
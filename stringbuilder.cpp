@@ -0,0 +1,105 @@
+#include "stringbuilder.hpp"
+#include <cstring>
+
+constexpr size_t MIN_CAPACITY = 32;
+
+
+stringbuilder::stringbuilder() :
+	buffer(nullptr), count(0), capacity(0)
+{}
+
+stringbuilder::stringbuilder(size_t capacity) : stringbuilder() {
+	this->reserve(capacity);
+}
+
+stringbuilder::stringbuilder(stringbuilder&& src) noexcept :
+	buffer(src.buffer), count(src.count), capacity(src.capacity)
+{
+	src.buffer = nullptr;
+	src.count = 0;
+	src.capacity = 0;
+}
+
+stringbuilder& stringbuilder::operator=(stringbuilder&& src) noexcept {
+	if (this == &src)
+		return *this;
+	delete[] this->buffer;
+	this->buffer = src.buffer;
+	this->count = src.count;
+	this->capacity = src.capacity;
+	src.buffer = nullptr;
+	src.count = 0;
+	src.capacity = 0;
+	return *this;
+}
+
+stringbuilder::~stringbuilder() {
+	delete[] this->buffer;
+}
+
+void stringbuilder::grow(size_t min_capacity) {
+	size_t new_capacity = this->capacity + this->capacity / 2;
+	if (new_capacity < min_capacity)
+		new_capacity = min_capacity;
+	if (new_capacity < MIN_CAPACITY)
+		new_capacity = MIN_CAPACITY;
+	char* new_buffer = new char[new_capacity];
+	if (this->count)
+		std::memcpy(new_buffer, this->buffer, this->count);
+	delete[] this->buffer;
+	this->buffer = new_buffer;
+	this->capacity = new_capacity;
+}
+
+stringbuilder& stringbuilder::append(const string& str) {
+	return this->append(str.view());
+}
+
+stringbuilder& stringbuilder::append(std::string_view str) {
+	return this->append(str.data(), str.size());
+}
+
+stringbuilder& stringbuilder::append(const char* str) {
+	return this->append(str, std::strlen(str));
+}
+
+stringbuilder& stringbuilder::append(const char* str, size_t sz) {
+	if (!sz)
+		return *this;
+	if (this->capacity - this->count < sz)
+		this->grow(this->count + sz);
+	std::memcpy(this->buffer + this->count, str, sz);
+	this->count += sz;
+	return *this;
+}
+
+stringbuilder& stringbuilder::append(char c) {
+	if (this->count == this->capacity)
+		this->grow(this->count + 1);
+	this->buffer[this->count++] = c;
+	return *this;
+}
+
+void stringbuilder::reserve(size_t capacity) {
+	if (capacity > this->capacity)
+		this->grow(capacity);
+}
+
+void stringbuilder::clear() {
+	this->count = 0;
+}
+
+size_t stringbuilder::length() const {
+	return this->count;
+}
+
+std::string_view stringbuilder::view() const {
+	return std::string_view(this->count ? this->buffer : "", this->count);
+}
+
+string stringbuilder::build() const {
+	// bound as is, so that a trailing zero byte appended to the builder is kept.
+	char* contents = this->buffer;
+	return string::fromBuffer(&contents, 0, this->count);
+}
+
@@ -0,0 +1,67 @@
+#pragma once
+#include "string.hpp"
+#include <cstddef>
+#include <string_view>
+
+/*
+Mutable buffer used to assemble a string out of many pieces.
+Appending copies the piece at the end of the buffer, which grows
+geometrically, so building a string of n bytes costs O(n) whatever
+the number of pieces. Nothing is hashed or interned until build()
+is called.
+*/
+class stringbuilder
+{
+	char* buffer;
+	size_t count;
+	size_t capacity;
+
+	void grow(size_t min_capacity);
+
+public:
+	stringbuilder();
+	/*
+	Creates a builder that can hold capacity bytes without growing.
+	*/
+	explicit stringbuilder(size_t capacity);
+	stringbuilder(stringbuilder&&) noexcept;
+	stringbuilder& operator =(stringbuilder&&) noexcept;
+	~stringbuilder();
+
+	/*
+	Copies a piece at the end of the buffer. A string converts to
+	both std::string_view and const char*, and a C string to both
+	std::string_view and string, so each has an overload of its own
+	for the call not to be ambiguous.
+	*/
+	stringbuilder& append(const string&);
+	stringbuilder& append(std::string_view);
+	stringbuilder& append(const char*);
+	stringbuilder& append(const char*, size_t);
+	stringbuilder& append(char);
+
+	/*
+	Makes room for at least capacity bytes in total.
+	*/
+	void reserve(size_t capacity);
+	/*
+	Forgets the contents, keeping the buffer for reuse.
+	*/
+	void clear();
+	size_t length() const;
+	/*
+	Returns the contents assembled so far. The view is invalidated
+	by the next append, reserve or clear.
+	*/
+	std::string_view view() const;
+
+	/*
+	Interns the contents assembled so far and returns them as a
+	string. The builder is left unchanged.
+	*/
+	string build() const;
+
+	stringbuilder(const stringbuilder&) = delete;
+	stringbuilder& operator =(const stringbuilder&) = delete;
+};
+
@@ -0,0 +1,217 @@
+#pragma once
+#include "string.hpp"
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/*
+Hash map from strings to values of type T.
+The pairs are stored densely, in a single vector, next to the hash of
+their key, and iterating the map walks that vector. Lookups go through
+an open-addressing index of entries holding the full hash of a key and
+the position of its pair, like StringResourceIndex does for resources,
+so probing only compares keys whose hashes are equal. Interned keys
+are hashed with the hash stored in their resource and compared by
+identity, so looking one up with a string never reads its bytes.
+Lookups also take std::string_view and const char*, without interning.
+Erasing a key moves the last pair into its place, so it does not keep
+the order of insertion. Iterators and references to values are
+invalidated by insertions and erasures. Keys are const, as changing
+one would leave it filed under the hash of the old key.
+*/
+template <typename T>
+class stringmap
+{
+public:
+	using value_type = std::pair<const string, T>;
+	using iterator = typename std::vector<value_type>::iterator;
+	using const_iterator = typename std::vector<value_type>::const_iterator;
+
+private:
+	struct Entry {
+		size_t hash;
+		size_t position;
+	};
+
+	static constexpr size_t EMPTY = (size_t)-1;
+	static constexpr size_t TOMBSTONE = (size_t)-2;
+	static constexpr size_t MIN_CAPACITY = 16;
+
+	std::vector<value_type> items;
+	std::vector<size_t> hashes;
+	std::vector<Entry> entries;
+	size_t tombstones;
+
+	// index of the entry of the key, or EMPTY if it is not in the map.
+	template <typename K>
+	size_t locate(const K& key, size_t hash) const {
+		if (this->entries.empty())
+			return EMPTY;
+		const size_t mask = this->entries.size() - 1;
+		for (size_t i = hash & mask;; i = (i + 1) & mask) {
+			const Entry& entry = this->entries[i];
+			if (entry.position == EMPTY)
+				return EMPTY;
+			if (entry.position != TOMBSTONE && entry.hash == hash &&
+				string::Equal()(this->items[entry.position].first, key))
+				return i;
+		}
+	}
+
+	// index of the entry pointing to the specified position.
+	size_t locatePosition(size_t hash, size_t position) const {
+		const size_t mask = this->entries.size() - 1;
+		size_t i = hash & mask;
+		while (this->entries[i].position != position)
+			i = (i + 1) & mask;
+		return i;
+	}
+
+	void place(size_t hash, size_t position) {
+		const size_t mask = this->entries.size() - 1;
+		size_t i = hash & mask;
+		while (this->entries[i].position != EMPTY) {
+			if (this->entries[i].position == TOMBSTONE) {
+				this->tombstones--;
+				break;
+			}
+			i = (i + 1) & mask;
+		}
+		this->entries[i] = Entry{ hash, position };
+	}
+
+	// rebuilds the index with room for count keys, purging tombstones.
+	// Keys are not hashed again.
+	void rebuild(size_t count) {
+		size_t capacity = MIN_CAPACITY;
+		while (capacity * 3 < count * 4 + 4)
+			capacity *= 2;
+		this->entries.assign(capacity, Entry{ 0, EMPTY });
+		this->tombstones = 0;
+		for (size_t i = 0; i < this->items.size(); i++)
+			this->place(this->hashes[i], i);
+	}
+
+	template <typename V>
+	iterator emplaceNew(const string& key, size_t hash, V&& value) {
+		if ((this->items.size() + this->tombstones + 1) * 4 > this->entries.size() * 3)
+			this->rebuild(this->items.size() * 2 + 1);
+		this->items.emplace_back(key, std::forward<V>(value));
+		this->hashes.push_back(hash);
+		this->place(hash, this->items.size() - 1);
+		return this->items.end() - 1;
+	}
+
+public:
+	stringmap() : tombstones(0) {}
+
+	template <typename K>
+	iterator find(const K& key) {
+		size_t entry = this->locate(key, string::Hash()(key));
+		return entry == EMPTY ? this->items.end() : this->items.begin() + this->entries[entry].position;
+	}
+	template <typename K>
+	const_iterator find(const K& key) const {
+		size_t entry = this->locate(key, string::Hash()(key));
+		return entry == EMPTY ? this->items.end() : this->items.begin() + this->entries[entry].position;
+	}
+	template <typename K>
+	bool contains(const K& key) const {
+		return this->locate(key, string::Hash()(key)) != EMPTY;
+	}
+
+	/*
+	Returns the value of the key, inserting a default constructed one
+	first if the key is not in the map.
+	*/
+	T& operator [](const string& key) {
+		size_t hash = string::Hash()(key);
+		size_t entry = this->locate(key, hash);
+		if (entry != EMPTY)
+			return this->items[this->entries[entry].position].second;
+		return this->emplaceNew(key, hash, T())->second;
+	}
+
+	/*
+	Maps the key to the value if it is not in the map yet. Returns the
+	pair of the key and whether it was inserted.
+	*/
+	std::pair<iterator, bool> insert(const string& key, const T& value) {
+		size_t hash = string::Hash()(key);
+		size_t entry = this->locate(key, hash);
+		if (entry != EMPTY)
+			return { this->items.begin() + this->entries[entry].position, false };
+		return { this->emplaceNew(key, hash, value), true };
+	}
+	std::pair<iterator, bool> insert(const string& key, T&& value) {
+		size_t hash = string::Hash()(key);
+		size_t entry = this->locate(key, hash);
+		if (entry != EMPTY)
+			return { this->items.begin() + this->entries[entry].position, false };
+		return { this->emplaceNew(key, hash, std::move(value)), true };
+	}
+
+	/*
+	Removes the key from the map. Returns whether it was found.
+	*/
+	template <typename K>
+	bool erase(const K& key) {
+		size_t entry = this->locate(key, string::Hash()(key));
+		if (entry == EMPTY)
+			return 0;
+		size_t position = this->entries[entry].position;
+		size_t last = this->items.size() - 1;
+		this->entries[entry].position = TOMBSTONE;
+		this->tombstones++;
+		if (position != last) {
+			this->entries[this->locatePosition(this->hashes[last], last)].position = position;
+			// the key can't be assigned to, so the pair is built again in place.
+			std::destroy_at(&this->items[position]);
+			std::construct_at(&this->items[position], std::move(this->items[last]));
+			this->hashes[position] = this->hashes[last];
+		}
+		this->items.pop_back();
+		this->hashes.pop_back();
+		return 1;
+	}
+
+	/*
+	Makes room for count keys, so that inserting up to that many never
+	rebuilds the index.
+	*/
+	void reserve(size_t count) {
+		this->items.reserve(count);
+		this->hashes.reserve(count);
+		if ((count + 1) * 4 > this->entries.size() * 3)
+			this->rebuild(count);
+	}
+
+	void clear() {
+		this->items.clear();
+		this->hashes.clear();
+		this->entries.clear();
+		this->tombstones = 0;
+	}
+
+	size_t size() const {
+		return this->items.size();
+	}
+	bool empty() const {
+		return this->items.empty();
+	}
+
+	iterator begin() {
+		return this->items.begin();
+	}
+	iterator end() {
+		return this->items.end();
+	}
+	const_iterator begin() const {
+		return this->items.begin();
+	}
+	const_iterator end() const {
+		return this->items.end();
+	}
+};
+
@@ -0,0 +1,71 @@
+#pragma once
+#include "string.hpp"
+#include "StringResource.hpp"
+#include "strhash.h"
+#include <cstddef>
+
+/*
+String literals known at compile time, written "abc"_s.
+Each distinct literal gets a static block laid out like a string
+resource, holding its bytes and terminator from the start, and its
+hash is computed at compile time. The block is registered in the list
+of string resources as it is, pinned, so no byte is copied, hashed or
+allocated at runtime, and copies of the literal never write to its
+reference count. Registration happens during static initialization,
+or at the first use of the literal if that comes earlier.
+*/
+
+template <size_t N>
+struct fixed_string {
+	char data[N];
+
+	constexpr fixed_string(const char (&str)[N]) : data() {
+		for (size_t i = 0; i < N; i++)
+			this->data[i] = str[i];
+	}
+
+	constexpr size_t size() const {
+		return N - 1;
+	}
+};
+
+template <fixed_string S>
+struct StringLiteral {
+	struct Block {
+		alignas(StringResource) unsigned char header[sizeof(StringResource)];
+		char contents[sizeof(S.data)];
+	};
+
+	static constexpr hash_t HASH = constantHash(S.data, S.size());
+
+	static Block block;
+	static const string& get();
+	static const bool registered;
+};
+
+// constant initialized, so that it is filled before any literal gets registered.
+template <fixed_string S>
+constinit typename StringLiteral<S>::Block StringLiteral<S>::block = [] {
+	Block res = {};
+	for (size_t i = 0; i < sizeof(S.data); i++)
+		res.contents[i] = S.data[i];
+	return res;
+}();
+
+template <fixed_string S>
+const string& StringLiteral<S>::get() {
+	static_assert(offsetof(Block, contents) == sizeof(StringResource), "the bytes must follow the header");
+	// referring to registered is what gets the literal registered at startup.
+	(void)&registered;
+	static const string value = string::fromStatic(&block, S.size(), HASH);
+	return value;
+}
+
+template <fixed_string S>
+const bool StringLiteral<S>::registered = (StringLiteral<S>::get(), true);
+
+template <fixed_string S>
+const string& operator ""_s() {
+	return StringLiteral<S>::get();
+}
+
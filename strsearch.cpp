@@ -0,0 +1,182 @@
+#include "strsearch.h"
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define STRSEARCH_SSE2
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+/*
+Substring search filters candidate positions on their first and last
+bytes before comparing the rest: a block of the haystack is compared
+against the first byte of the needle, the same block shifted by the
+size of the needle minus one against its last byte, and only positions
+where both match are checked with memcmp. This rejects almost every
+position of real text 16 or 32 at a time.
+The SSE2 kernel is always available on x86-64. The AVX2 kernel is
+picked at runtime when the processor supports it, and other platforms
+use the scalar fallback. All of them return the same position.
+
+Delimiter scans compare 16 bytes at a time against every delimiter of
+the set and merge the results, as long as the set is small enough for
+that to beat a lookup table. They report every delimiter of the block
+at once, so short tokens don't pay for a new scan each.
+*/
+
+namespace {
+
+	size_t findScalar(const char* haystack, size_t haystack_size, const char* needle, size_t needle_size, size_t from) {
+		const char first = needle[0];
+		const char last = needle[needle_size - 1];
+		for (size_t i = from; i + needle_size <= haystack_size; i++) {
+			if (haystack[i] == first && haystack[i + needle_size - 1] == last &&
+				!std::memcmp(haystack + i + 1, needle + 1, needle_size - 2 + (needle_size < 2)))
+				return i;
+		}
+		return SEARCH_NOT_FOUND;
+	}
+
+#ifdef STRSEARCH_SSE2
+
+	// index of the lowest set bit of a non-zero mask.
+	inline unsigned lowestBit(uint32_t mask) {
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return (unsigned)index;
+#else
+		return (unsigned)__builtin_ctz(mask);
+#endif
+	}
+
+	size_t findSSE2(const char* haystack, size_t haystack_size, const char* needle, size_t needle_size) {
+		const __m128i first = _mm_set1_epi8(needle[0]);
+		const __m128i last = _mm_set1_epi8(needle[needle_size - 1]);
+		size_t i = 0;
+		for (; i + needle_size - 1 + 16 <= haystack_size; i += 16) {
+			__m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i));
+			__m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i + needle_size - 1));
+			__m128i eq = _mm_and_si128(_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last));
+			uint32_t mask = (uint32_t)_mm_movemask_epi8(eq);
+			while (mask) {
+				unsigned bit = lowestBit(mask);
+				if (!std::memcmp(haystack + i + bit + 1, needle + 1, needle_size - 2))
+					return i + bit;
+				mask &= mask - 1;
+			}
+		}
+		return findScalar(haystack, haystack_size, needle, needle_size, i);
+	}
+
+#if defined(__GNUC__) || defined(__clang__)
+	__attribute__((target("avx2")))
+#endif
+	size_t findAVX2(const char* haystack, size_t haystack_size, const char* needle, size_t needle_size) {
+		const __m256i first = _mm256_set1_epi8(needle[0]);
+		const __m256i last = _mm256_set1_epi8(needle[needle_size - 1]);
+		size_t i = 0;
+		for (; i + needle_size - 1 + 32 <= haystack_size; i += 32) {
+			__m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i));
+			__m256i block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i + needle_size - 1));
+			__m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(block_first, first), _mm256_cmpeq_epi8(block_last, last));
+			uint32_t mask = (uint32_t)_mm256_movemask_epi8(eq);
+			while (mask) {
+				unsigned bit = lowestBit(mask);
+				if (!std::memcmp(haystack + i + bit + 1, needle + 1, needle_size - 2))
+					return i + bit;
+				mask &= mask - 1;
+			}
+		}
+		size_t res = findSSE2(haystack + i, haystack_size - i, needle, needle_size);
+		return res == SEARCH_NOT_FOUND ? res : res + i;
+	}
+
+	bool detectAVX2() {
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return 0;
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+			return 0;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+
+	const bool HAS_AVX2 = detectAVX2();
+
+#endif
+}
+
+
+size_t findSubstring(const char* haystack, size_t haystack_size, const char* needle, size_t needle_size) {
+	if (!needle_size)
+		return 0;
+	if (needle_size > haystack_size)
+		return SEARCH_NOT_FOUND;
+	if (needle_size == 1) {
+		const void* res = std::memchr(haystack, needle[0], haystack_size);
+		return res ? (size_t)(static_cast<const char*>(res) - haystack) : SEARCH_NOT_FOUND;
+	}
+#ifdef STRSEARCH_SSE2
+	if (HAS_AVX2) {
+		return findAVX2(haystack, haystack_size, needle, needle_size);
+	}
+	return findSSE2(haystack, haystack_size, needle, needle_size);
+#else
+	return findScalar(haystack, haystack_size, needle, needle_size, 0);
+#endif
+}
+
+DelimiterSet::DelimiterSet(const char* delimiters) :
+	table(), bytes(), count(0)
+{
+	for (const char* pos = delimiters; *pos; pos++) {
+		unsigned char c = (unsigned char)*pos;
+		if (this->table[c])
+			continue;
+		this->table[c] = 1;
+		if (this->count < MAX_VECTORIZED)
+			this->bytes[this->count] = *pos;
+		this->count++;
+	}
+}
+
+size_t findDelimiters(const DelimiterSet& set, const char* str, size_t sz, size_t* positions) {
+	size_t found = 0;
+	size_t i = 0;
+#ifdef STRSEARCH_SSE2
+	if (set.count && set.count <= DelimiterSet::MAX_VECTORIZED) {
+		__m128i delimiters[DelimiterSet::MAX_VECTORIZED];
+		for (size_t k = 0; k < set.count; k++)
+			delimiters[k] = _mm_set1_epi8(set.bytes[k]);
+		for (; i + 16 <= sz; i += 16) {
+			__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+			__m128i eq = _mm_cmpeq_epi8(block, delimiters[0]);
+			for (size_t k = 1; k < set.count; k++)
+				eq = _mm_or_si128(eq, _mm_cmpeq_epi8(block, delimiters[k]));
+			uint32_t mask = (uint32_t)_mm_movemask_epi8(eq);
+			while (mask) {
+				positions[found++] = i + lowestBit(mask);
+				mask &= mask - 1;
+			}
+		}
+	}
+#endif
+	for (; i < sz; i++) {
+		if (set.table[(unsigned char)str[i]])
+			positions[found++] = i;
+	}
+	return found;
+}
+
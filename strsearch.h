@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+
+constexpr size_t SEARCH_NOT_FOUND = (size_t)-1;
+
+/*
+Returns the position of the first occurrence of needle inside haystack,
+or SEARCH_NOT_FOUND if there is none. An empty needle is found at 0.
+*/
+size_t findSubstring(const char* haystack, size_t haystack_size, const char* needle, size_t needle_size);
+
+/*
+Set of delimiter bytes, prepared once for any number of scans.
+*/
+struct DelimiterSet {
+	static constexpr size_t MAX_VECTORIZED = 8;
+
+	bool table[256];
+	char bytes[MAX_VECTORIZED];
+	size_t count;
+
+	/*
+	Builds the set out of the bytes of a zero terminated string.
+	*/
+	explicit DelimiterSet(const char* delimiters);
+};
+
+/*
+Stores the positions of the bytes of str that belong to the set into
+positions, in increasing order, and returns how many there are.
+positions must have room for sz entries.
+*/
+size_t findDelimiters(const DelimiterSet& set, const char* str, size_t sz, size_t* positions);
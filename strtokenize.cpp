@@ -0,0 +1,171 @@
+#include "strtokenize.h"
+#include "strsearch.h"
+#include <cerrno>
+#include <iterator>
+#include <system_error>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+The contents are scanned for delimiters CHUNK_SIZE bytes at a time.
+Tokens are gathered as views over the contents and handed over to
+string::internMany BATCH_SIZE at a time. That bounds the memory taken
+by the views, while keeping batches large enough for repeated tokens
+to be merged and for each shard of the table to be locked only once
+per batch.
+*/
+
+constexpr size_t BATCH_SIZE = 64 * 1024;
+constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+
+namespace {
+
+	/*
+	Read-only view of a whole file mapped in memory.
+	*/
+	class MappedFile
+	{
+		const char* contents;
+		size_t size;
+#ifdef _WIN32
+		HANDLE file;
+		HANDLE mapping;
+#else
+		int fd;
+#endif
+
+	public:
+		explicit MappedFile(const char* path);
+		~MappedFile();
+
+		std::string_view view() const {
+			return std::string_view(this->size ? this->contents : "", this->size);
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator =(const MappedFile&) = delete;
+	};
+
+#ifdef _WIN32
+
+	MappedFile::MappedFile(const char* path) :
+		contents(nullptr), size(0), file(INVALID_HANDLE_VALUE), mapping(nullptr)
+	{
+		this->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (this->file == INVALID_HANDLE_VALUE)
+			throw std::system_error((int)GetLastError(), std::system_category(), path);
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(this->file, &file_size)) {
+			DWORD error = GetLastError();
+			CloseHandle(this->file);
+			throw std::system_error((int)error, std::system_category(), path);
+		}
+		this->size = (size_t)file_size.QuadPart;
+		if (!this->size)
+			return;
+		this->mapping = CreateFileMappingA(this->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (this->mapping)
+			this->contents = static_cast<const char*>(MapViewOfFile(this->mapping, FILE_MAP_READ, 0, 0, 0));
+		if (!this->contents) {
+			DWORD error = GetLastError();
+			if (this->mapping)
+				CloseHandle(this->mapping);
+			CloseHandle(this->file);
+			throw std::system_error((int)error, std::system_category(), path);
+		}
+	}
+
+	MappedFile::~MappedFile() {
+		if (this->contents)
+			UnmapViewOfFile(this->contents);
+		if (this->mapping)
+			CloseHandle(this->mapping);
+		CloseHandle(this->file);
+	}
+
+#else
+
+	MappedFile::MappedFile(const char* path) :
+		contents(nullptr), size(0), fd(-1)
+	{
+		this->fd = open(path, O_RDONLY);
+		if (this->fd < 0)
+			throw std::system_error(errno, std::generic_category(), path);
+		struct stat info;
+		if (fstat(this->fd, &info) < 0) {
+			int error = errno;
+			close(this->fd);
+			throw std::system_error(error, std::generic_category(), path);
+		}
+		this->size = (size_t)info.st_size;
+		if (!this->size)
+			return;
+		void* mapped = mmap(nullptr, this->size, PROT_READ, MAP_PRIVATE, this->fd, 0);
+		if (mapped == MAP_FAILED) {
+			int error = errno;
+			close(this->fd);
+			throw std::system_error(error, std::generic_category(), path);
+		}
+		// the file is read once from start to end.
+		madvise(mapped, this->size, MADV_SEQUENTIAL);
+		this->contents = static_cast<const char*>(mapped);
+	}
+
+	MappedFile::~MappedFile() {
+		if (this->contents)
+			munmap(const_cast<char*>(this->contents), this->size);
+		close(this->fd);
+	}
+
+#endif
+
+	void flushBatch(std::vector<std::string_view>& batch, std::vector<string>& res) {
+		std::vector<string> interned = string::internMany(batch);
+		res.insert(res.end(), std::make_move_iterator(interned.begin()), std::make_move_iterator(interned.end()));
+		batch.clear();
+	}
+}
+
+
+std::vector<string> tokenize(std::string_view contents, const char* delimiters) {
+	DelimiterSet set(delimiters);
+	std::vector<string> res;
+	std::vector<std::string_view> batch;
+	batch.reserve(BATCH_SIZE);
+	std::vector<size_t> positions(CHUNK_SIZE);
+
+	const char* start = contents.data();
+	const char* end = start + contents.size();
+	for (const char* chunk = start; chunk < end; chunk += CHUNK_SIZE) {
+		size_t chunk_size = (size_t)(end - chunk) < CHUNK_SIZE ? (size_t)(end - chunk) : CHUNK_SIZE;
+		size_t found = findDelimiters(set, chunk, chunk_size, positions.data());
+		for (size_t k = 0; k < found; k++) {
+			const char* delimiter = chunk + positions[k];
+			if (delimiter > start) {
+				batch.emplace_back(start, delimiter - start);
+				if (batch.size() == BATCH_SIZE)
+					flushBatch(batch, res);
+			}
+			start = delimiter + 1;
+		}
+	}
+	if (end > start)
+		batch.emplace_back(start, end - start);
+	flushBatch(batch, res);
+	return res;
+}
+
+std::vector<string> tokenizeFile(const char* path, const char* delimiters) {
+	MappedFile file(path);
+	return tokenize(file.view(), delimiters);
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "string.hpp"
+#include <string_view>
+#include <vector>
+
+/*
+Splits contents on every byte of delimiters and returns the non-empty
+tokens in order, interned in batches.
+*/
+std::vector<string> tokenize(std::string_view contents, const char* delimiters);
+
+/*
+Maps the file at path in memory and tokenizes its contents like
+tokenize does, without reading the file into an intermediate buffer.
+Throws std::system_error if the file can't be opened or mapped.
+*/
+std::vector<string> tokenizeFile(const char* path, const char* delimiters);